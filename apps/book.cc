@@ -0,0 +1,167 @@
+// Builds an opening book (see book.h) by searching all positions of the first
+// few turns of the game with a slow but strong player, e.g.:
+//
+//   book --threads=8 --plies=1 minimax,max_depth=6 opening.book
+//
+// searches the initial position and every position after the first turn. With
+// --teams, the same is done for each of the 924 ways to divide the gods into
+// two teams of 6 (as in apps/evaluate.cc).
+//
+// The result can be used with: play minimax,book=opening.book ...
+
+#include "book.h"
+#include "moves.h"
+#include "players.h"
+#include "state.h"
+
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace {
+
+constexpr int default_plies = 1;
+
+void PrintUsage() {
+    std::cout <<
+        "Usage:\n"
+        "\n"
+        "   book [--threads=<n>] [--plies=<n>] [--teams] <player> <output>\n"
+        "\n"
+        "       Selects a turn with the given player for each position in the\n"
+        "       first turns of the game, and writes them to the output file.\n"
+        "\n"
+        "Options:\n"
+        "\n"
+        "   --threads=<n>   Number of positions to search in parallel (default: 1)\n"
+        "   --plies=<n>     Number of turns after the start to include; every\n"
+        "                   turn is expanded, so each turn multiplies the number\n"
+        "                   of positions by about 100 (default: 1)\n"
+        "   --teams         Start from all 6v6 teams, instead of from the default\n"
+        "                   initial state where all gods are summonable\n"
+        "\n";
+}
+
+bool ParseInt(std::string_view sv, int &value) {
+    auto [ptr, ec] = std::from_chars(sv.data(), sv.data() + sv.size(), value);
+    return ec == std::errc{} && ptr == sv.data() + sv.size();
+}
+
+std::vector<State> InitialStates(bool teams) {
+    if (!teams) return {State::InitialAllSummonable()};
+    std::vector<State> states;
+    for (god_mask_t light = 0; light <= ALL_GODS; ++light) {
+        if (std::popcount(light) != GOD_COUNT / 2) continue;
+        states.push_back(State::InitialWithSummonable({light, static_cast<god_mask_t>(ALL_GODS & ~light)}));
+    }
+    return states;
+}
+
+// Returns all unique positions reached within `plies` turns from the given
+// states, where the game is not (almost) over yet.
+std::vector<State> CollectPositions(const std::vector<State> &initial_states, int plies) {
+    std::vector<State> positions;
+    std::unordered_set<uint64_t> seen;
+    for (const State &state : initial_states) {
+        if (seen.insert(state.Hash()).second) positions.push_back(state);
+    }
+    std::vector<Turn> turns;
+    StateHashSet seen_turns;
+    size_t level_begin = 0;
+    for (int ply = 0; ply < plies; ++ply) {
+        size_t level_end = positions.size();
+        for (size_t i = level_begin; i < level_end; ++i) {
+            GenerateUniqueTurns(positions[i], turns, seen_turns);
+            for (const Turn &turn : turns) {
+                State next = positions[i];
+                ExecuteTurn(next, turn);
+                if (!next.IsAlmostOver() && seen.insert(next.Hash()).second) positions.push_back(next);
+            }
+        }
+        level_begin = level_end;
+    }
+    return positions;
+}
+
+int Build(const PlayerDesc &desc, int plies, bool teams, int threads, const std::string &output) {
+    std::vector<State> positions = CollectPositions(InitialStates(teams), plies);
+    std::cerr << "Positions: " << positions.size() << '\n';
+
+    std::vector<std::optional<Turn>> turns(positions.size());
+    std::atomic<size_t> next_position = 0;
+    std::atomic<bool> failed = false;
+    int positions_searched = 0;  // protected by output_mutex
+    std::mutex output_mutex;
+    auto work = [&]() {
+        std::unique_ptr<GamePlayer> player(CreatePlayerFromDesc(desc));
+        if (!player) {
+            failed = true;
+            return;
+        }
+        while (!failed) {
+            size_t i = next_position++;
+            if (i >= positions.size()) break;
+            turns[i] = player->SelectTurn(positions[i]);
+            std::lock_guard<std::mutex> lock(output_mutex);
+            std::cerr << "\rPositions searched: " << ++positions_searched << " / " << positions.size() << std::flush;
+        }
+    };
+    std::vector<std::thread> workers;
+    for (int i = 1; i < threads; ++i) workers.emplace_back(work);
+    work();
+    for (std::thread &worker : workers) worker.join();
+    std::cerr << '\n';
+    if (failed) return 1;
+
+    std::vector<std::pair<uint64_t, Turn>> entries;
+    for (size_t i = 0; i < positions.size(); ++i) {
+        if (turns[i]) entries.emplace_back(positions[i].Hash(), *turns[i]);
+    }
+    if (!WriteOpeningBook(output, entries)) {
+        std::cerr << "Failed to write " << output << '\n';
+        return 1;
+    }
+    return 0;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+    int threads = 1;
+    int plies = default_plies;
+    bool teams = false;
+    int argi = 1;
+    for (; argi < argc && std::string_view(argv[argi]).starts_with("--"); ++argi) {
+        std::string_view arg = argv[argi];
+        if (arg.starts_with("--threads=") && ParseInt(arg.substr(10), threads) && threads > 0) {
+            // threads parsed above
+        } else if (arg.starts_with("--plies=") && ParseInt(arg.substr(8), plies) && plies >= 0) {
+            // plies parsed above
+        } else if (arg == "--teams") {
+            teams = true;
+        } else {
+            std::cerr << "Invalid option: " << arg << '\n';
+            return 1;
+        }
+    }
+    if (argc - argi != 2) {
+        PrintUsage();
+        return 1;
+    }
+    std::optional<PlayerDesc> desc = ParsePlayerDesc(argv[argi]);
+    if (!desc) {
+        std::cerr << "Failed to parse player type: " << argv[argi] << '\n';
+        return 1;
+    }
+    return Build(*desc, plies, teams, threads, argv[argi + 1]);
+}
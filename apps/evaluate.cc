@@ -166,6 +166,9 @@ int main(int argc, char *argv[]) {
         std::cerr << "Couldn't parse player description!" << std::endl;
         return 1;
     }
+    if (!ValidatePlayerDesc(*player_desc)) {
+        return 1;
+    }
 
     // This plays random matches where each player has 11 out of 12 gods,
     // with one missing, and counting the outcomes.
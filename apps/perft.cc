@@ -0,0 +1,86 @@
+// Counts the leaf nodes of the turn tree up to a given depth, to validate and
+// benchmark the turn generator. See perft.h for details.
+
+#include "perft.h"
+#include "state.h"
+
+#include <charconv>
+#include <chrono>
+#include <iostream>
+#include <string_view>
+
+namespace {
+
+void PrintUsage() {
+    std::cout <<
+        "Usage: perft [--divide] [--threads=<n>] <depth> [<state>]\n"
+        "\n"
+        "Counts the leaf nodes of the turn tree of the given depth, starting\n"
+        "from the given state (default: the initial state).\n"
+        "\n"
+        "Options:\n"
+        "\n"
+        "   --divide        Print the count for each turn at the root\n"
+        "   --threads=<n>   Number of threads to use (default: 1)\n"
+        "\n";
+}
+
+bool ParseInt(std::string_view sv, int &value) {
+    auto [ptr, ec] = std::from_chars(sv.data(), sv.data() + sv.size(), value);
+    return ec == std::errc{} && ptr == sv.data() + sv.size();
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+    bool divide = false;
+    int threads = 1;
+    int argi = 1;
+    for (; argi < argc && std::string_view(argv[argi]).starts_with("--"); ++argi) {
+        std::string_view arg = argv[argi];
+        if (arg == "--divide") {
+            divide = true;
+        } else if (arg.starts_with("--threads=") && ParseInt(arg.substr(10), threads) && threads > 0) {
+            // threads parsed above
+        } else {
+            std::cerr << "Invalid option: " << arg << '\n';
+            return 1;
+        }
+    }
+    if (argc - argi < 1 || argc - argi > 2) {
+        PrintUsage();
+        return 1;
+    }
+    int depth = 0;
+    if (!ParseInt(argv[argi], depth) || depth < 0) {
+        std::cerr << "Invalid depth: " << argv[argi] << '\n';
+        return 1;
+    }
+    ++argi;
+    State state = State::InitialAllSummonable();
+    if (argi < argc) {
+        if (auto s = State::Decode(argv[argi]); !s) {
+            std::cerr << "Failed to decode state: " << argv[argi] << '\n';
+            return 1;
+        } else {
+            state = *s;
+        }
+        ++argi;
+    }
+
+    auto start_time = std::chrono::steady_clock::now();
+    int64_t count = 0;
+    if (depth > 0 && (divide || threads > 1)) {
+        for (const PerftDivideResult &result : PerftDivide(state, depth, threads)) {
+            if (divide) std::cout << result.turn << ' ' << result.count << '\n';
+            count += result.count;
+        }
+    } else {
+        count = Perft(state, depth);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+
+    std::cout << "Nodes: " << count << '\n';
+    std::cerr << "Time: " << elapsed.count() << " s\n";
+    std::cerr << "Nodes/second: " << static_cast<int64_t>(count / elapsed.count()) << '\n';
+}
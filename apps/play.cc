@@ -19,12 +19,46 @@ void PrintUsage() {
         "   cli:      play manually via the command line interface\n"
         "   random:   play randomly\n"
         "   minimax:  Minimax algorithm\n"
-        "   mcts:     Monte Carlo Tree Search algorithm (incomplete)\n"
+        "   mcts:     Monte Carlo Tree Search algorithm\n"
         "\n"
         "Algorithm specific options:\n"
         "\n"
-        "   minimax,max_depth=<n>   Maximum search depth (default: 4)\n"
+        "   minimax,max_depth=<n>   Maximum search depth (default: 4, or no limit if\n"
+        "                           max_time_ms is given)\n"
+        "   minimax,max_time_ms=<n> Search with iterative deepening until the time limit\n"
+        "                           is reached (default: no time limit)\n"
+        "   minimax,tt_mb=<n>       Transposition table size in MB (default: 16, 0 to disable)\n"
+        "   minimax,threads=<n>     Number of search threads (default: 1)\n"
+        "   minimax,weights=<path>  Read evaluation weights from a file (see apps/tune)\n"
+        "   minimax,ordering=<o>    Move ordering: search (by a shallower search) or\n"
+        "                           heuristic (hash, killer and history heuristics)\n"
+        "                           (default: search)\n"
+        "   minimax,pvs             Use principal variation search\n"
+        "   minimax,aspiration_window=<n>\n"
+        "                           Search each iteration of iterative deepening with a\n"
+        "                           window of +/- n around the previous value first\n"
+        "   minimax,shuffle_root    Select a random optimal turn by shuffling the root\n"
+        "                           turns, instead of searching for all optimal turns\n"
+        "   minimax,qsearch         Extend the search at the leaves with kills, attacks\n"
+        "                           on damaged gods and turns towards the enemy gate\n"
+        "   minimax,qsearch_depth=<n>\n"
+        "                           Maximum quiescence search depth; implies qsearch\n"
+        "                           (default: 4)\n"
+        "   minimax,null_move       Use null-move pruning\n"
+        "   minimax,lmr             Use late-move reductions for quiet turns\n"
+        "   minimax,tablebase=<path>\n"
+        "                           Look up endgame positions in a tablebase (see\n"
+        "                           apps/tbgen)\n"
+        "   minimax,book=<path>     Play turns from an opening book (see apps/book)\n"
         "   minimax,experiment      Enable experimental behavior (do not use)\n"
+        "\n"
+        "   mcts,iterations=<n>     Number of search iterations (default: 10000)\n"
+        "   mcts,exploration=<c>    UCT exploration constant (default: 1.4)\n"
+        "   mcts,policy=<p>         Playout policy: random or heavy (default: random)\n"
+        "   mcts,threads=<n>        Number of search threads (default: 1)\n"
+        "   mcts,tablebase=<path>   End playouts in endgame positions found in a\n"
+        "                           tablebase (see apps/tbgen)\n"
+        "   mcts,book=<path>        Play turns from an opening book (see apps/book)\n"
         "\n";
 }
 
@@ -46,6 +80,7 @@ int main(int argc, char *argv[]) {
                 return 1;
             } else {
                 game_players[p].reset(CreatePlayerFromDesc(*pt));
+                if (!game_players[p]) return 1;
             }
             ++argi;
         }
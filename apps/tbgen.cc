@@ -0,0 +1,108 @@
+// Generates endgame tablebases (see tablebase.h) for positions with only a few
+// gods in play and no gods left to summon, e.g.:
+//
+//   tbgen --max-gods=2 endgame.tb
+//
+// generates all materials with at most two gods in play. Tables for larger
+// materials take much longer to generate, so they are best generated one at a
+// time, e.g. Athena against Artemis and Hades:
+//
+//   tbgen --max-gods=3 endgame3.tb N/TS
+//
+// The result can be used with: play minimax,tablebase=endgame.tb ...
+
+#include "state.h"
+#include "tablebase.h"
+
+#include <bit>
+#include <charconv>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+constexpr int default_max_gods = 2;
+
+// Tables with 4 or more gods are too large to generate (see tablebase.h).
+constexpr int max_max_gods = 3;
+
+void PrintUsage() {
+    std::cout <<
+        "Usage:\n"
+        "\n"
+        "   tbgen [--max-gods=<n>] <output> [<material>...]\n"
+        "\n"
+        "       Generates tables for the given materials, and writes them to the\n"
+        "       output file. A material lists the ASCII ids of the light gods, a\n"
+        "       slash, and the ASCII ids of the dark gods, e.g. N/TS. Tables for\n"
+        "       all materials that can be reached by killing gods are included.\n"
+        "\n"
+        "       Without materials, generates all materials with at most n gods.\n"
+        "\n"
+        "Options:\n"
+        "\n"
+        "   --max-gods=<n>   Maximum number of gods in play, at most 3 (default: 2)\n"
+        "\n";
+}
+
+bool ParseInt(std::string_view sv, int &value) {
+    auto [ptr, ec] = std::from_chars(sv.data(), sv.data() + sv.size(), value);
+    return ec == std::errc{} && ptr == sv.data() + sv.size();
+}
+
+// Returns all materials with exactly `count` gods in play. Smaller materials
+// are generated along with them.
+std::vector<Material> AllMaterials(int count) {
+    std::vector<Material> materials;
+    for (uint32_t bits = 0; bits < uint32_t{1} << (2 * GOD_COUNT); ++bits) {
+        if (std::popcount(bits) != count) continue;
+        materials.push_back(Material{{
+            static_cast<god_mask_t>(bits & ALL_GODS),
+            static_cast<god_mask_t>(bits >> GOD_COUNT),
+        }});
+    }
+    return materials;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+    int max_gods = default_max_gods;
+    int argi = 1;
+    for (; argi < argc && std::string_view(argv[argi]).starts_with("--"); ++argi) {
+        std::string_view arg = argv[argi];
+        if (arg.starts_with("--max-gods=") && ParseInt(arg.substr(11), max_gods) &&
+                max_gods > 0 && max_gods <= max_max_gods) {
+            // max_gods parsed above
+        } else {
+            std::cerr << "Invalid option: " << arg << '\n';
+            return 1;
+        }
+    }
+    if (argi >= argc) {
+        PrintUsage();
+        return 1;
+    }
+    std::string output = argv[argi++];
+
+    std::vector<Material> materials;
+    for (; argi < argc; ++argi) {
+        std::optional<Material> material = Material::Parse(argv[argi]);
+        if (!material || material->Count() == 0) {
+            std::cerr << "Invalid material: " << argv[argi] << '\n';
+            return 1;
+        }
+        if (material->Count() > max_gods) {
+            std::cerr << "Material " << argv[argi] << " has more than " << max_gods << " gods\n";
+            return 1;
+        }
+        materials.push_back(*material);
+    }
+    if (materials.empty()) materials = AllMaterials(max_gods);
+
+    if (!GenerateTablebase(materials, output, &std::cerr)) return 1;
+    return 0;
+}
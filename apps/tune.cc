@@ -0,0 +1,309 @@
+// Tunes the weights of the static evaluation function (see eval.h) so that it
+// predicts the outcomes of games as well as possible, using the method that
+// Peter Österlund described for his chess engine Texel.
+//
+// This works in two steps. First, positions are collected from self-play
+// games, together with the final outcome of the game they occurred in:
+//
+//   tune selfplay minimax,max_depth=2 1000 > positions.txt
+//
+// Then, the weights are fitted to minimize the mean squared error between the
+// outcomes and the predicted win probabilities, sigmoid(K * Evaluate(state)),
+// where K is a scaling constant that is fitted to the initial weights first:
+//
+//   tune fit positions.txt > weights.txt
+//
+// The result can be used with: play minimax,weights=weights.txt ...
+
+#include "eval.h"
+#include "moves.h"
+#include "players.h"
+#include "random.h"
+#include "state.h"
+
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Number of random turns played at the start of each self-play game, so that
+// games are diverse even if the players are deterministic.
+constexpr int random_opening_turns = 4;
+
+// Games that take longer than this are ruled a draw.
+constexpr int max_game_turns = 300;
+
+// Search range for the scaling constant K, as powers of 10.
+constexpr double min_log_k = -7.0;
+constexpr double max_log_k = 0.0;
+constexpr int k_search_iterations = 50;
+
+// Maximum number of passes over all weights during fitting, and the minimum
+// reduction of the error for a weight change to be accepted.
+constexpr int max_fit_passes = 1000;
+constexpr double min_error_reduction = 1e-9;
+
+void PrintUsage() {
+    std::cout <<
+        "Usage:\n"
+        "\n"
+        "   tune selfplay [--threads=<n>] <player> <games>\n"
+        "\n"
+        "       Plays games of the given player against itself, and prints the\n"
+        "       positions that occurred, followed by the final score for the\n"
+        "       light player (1 for a win, 0.5 for a draw, 0 for a loss).\n"
+        "\n"
+        "   tune fit [--threads=<n>] <positions> [<weights>]\n"
+        "\n"
+        "       Fits evaluation weights to the positions printed by selfplay,\n"
+        "       starting from the given weights (default: built-in weights),\n"
+        "       and prints the result in the format used by minimax,weights.\n"
+        "\n"
+        "Options:\n"
+        "\n"
+        "   --threads=<n>   Number of threads to use (default: 1)\n"
+        "\n";
+}
+
+bool ParseInt(std::string_view sv, int &value) {
+    auto [ptr, ec] = std::from_chars(sv.data(), sv.data() + sv.size(), value);
+    return ec == std::errc{} && ptr == sv.data() + sv.size();
+}
+
+// Returns the final score for the light player.
+double FinalScore(const State &state) {
+    int w = state.AlmostWinner();
+    return w == LIGHT ? 1.0 : w == DARK ? 0.0 : 0.5;
+}
+
+// Plays a single game and returns the positions that occurred after the
+// random opening, and the final score for the light player.
+double PlayGame(GamePlayer *players[2], rng_t &rng, std::vector<State> &positions) {
+    positions.clear();
+    State state = State::InitialAllSummonable();
+    for (int turns = 0; turns < max_game_turns; ++turns) {
+        if (state.IsAlmostOver()) return FinalScore(state);
+        if (turns < random_opening_turns) {
+            ExecuteTurn(state, SampleTurn(state, rng));
+            continue;
+        }
+        positions.push_back(state);
+        std::optional<Turn> turn = players[state.NextPlayer()]->SelectTurn(state);
+        if (!turn) break;
+        ExecuteTurn(state, *turn);
+    }
+    return 0.5;  // too many turns
+}
+
+int SelfPlay(const PlayerDesc &desc, int games, int threads) {
+    std::atomic<int> next_game = 0;
+    int games_played = 0;  // protected by output_mutex
+    std::atomic<bool> failed = false;
+    std::mutex output_mutex;
+    auto work = [&]() {
+        std::unique_ptr<GamePlayer> light(CreatePlayerFromDesc(desc));
+        std::unique_ptr<GamePlayer> dark(CreatePlayerFromDesc(desc));
+        if (!light || !dark) {
+            failed = true;
+            return;
+        }
+        GamePlayer *players[2] = {light.get(), dark.get()};
+        rng_t rng = InitializeRng();
+        std::vector<State> positions;
+        while (!failed) {
+            int game = next_game++;
+            if (game >= games) break;
+            double score = PlayGame(players, rng, positions);
+            std::lock_guard<std::mutex> lock(output_mutex);
+            for (const State &state : positions) std::cout << state.Encode() << ' ' << score << '\n';
+            std::cerr << "\rGames played: " << ++games_played << " / " << games << std::flush;
+        }
+    };
+    std::vector<std::thread> workers;
+    for (int i = 1; i < threads; ++i) workers.emplace_back(work);
+    work();
+    for (std::thread &worker : workers) worker.join();
+    std::cerr << '\n';
+    return failed ? 1 : 0;
+}
+
+struct Position {
+    EvalFeatures features;
+    double score;  // final score for the next player
+};
+
+std::optional<std::vector<Position>> ReadPositions(const std::string &path) {
+    std::ifstream ifs(path);
+    if (!ifs) return {};
+    std::vector<Position> positions;
+    std::string encoded;
+    double light_score;
+    while (ifs >> encoded >> light_score) {
+        std::optional<State> state = State::Decode(encoded);
+        if (!state) return {};
+        positions.push_back(Position{
+            .features = GetEvalFeatures(*state),
+            .score    = state->NextPlayer() == LIGHT ? light_score : 1.0 - light_score,
+        });
+    }
+    if (!ifs.eof()) return {};
+    return positions;
+}
+
+// Returns the mean squared error between the scores of the positions and the
+// win probabilities predicted by the evaluation function. The positions are
+// divided between threads.
+double MeanSquaredError(const std::vector<Position> &positions, const EvalWeights &weights, double k, int threads) {
+    std::vector<double> sums(threads);
+    auto work = [&](int thread) {
+        size_t begin = positions.size() * thread / threads;
+        size_t end = positions.size() * (thread + 1) / threads;
+        double sum = 0;
+        for (size_t i = begin; i < end; ++i) {
+            const Position &position = positions[i];
+            double value = 0;
+            for (int j = 0; j < EVAL_TERM_COUNT; ++j) value += weights[j] * position.features[j];
+            double error = position.score - 1.0 / (1.0 + std::exp(-k * value));
+            sum += error * error;
+        }
+        sums[thread] = sum;
+    };
+    std::vector<std::thread> workers;
+    for (int i = 1; i < threads; ++i) workers.emplace_back(work, i);
+    work(0);
+    for (std::thread &worker : workers) worker.join();
+    double sum = 0;
+    for (double s : sums) sum += s;
+    return sum / std::max<size_t>(positions.size(), 1);
+}
+
+// Finds the scaling constant K that minimizes the error for the given weights,
+// using a golden section search over log10(K).
+double FitScale(const std::vector<Position> &positions, const EvalWeights &weights, int threads) {
+    const double phi = (std::sqrt(5.0) - 1) / 2;
+    auto error = [&](double log_k) {
+        return MeanSquaredError(positions, weights, std::pow(10.0, log_k), threads);
+    };
+    double a = min_log_k, b = max_log_k;
+    double c = b - phi * (b - a), d = a + phi * (b - a);
+    double error_c = error(c), error_d = error(d);
+    for (int i = 0; i < k_search_iterations; ++i) {
+        if (error_c < error_d) {
+            b = d, d = c, error_d = error_c;
+            c = b - phi * (b - a), error_c = error(c);
+        } else {
+            a = c, c = d, error_c = error_d;
+            d = a + phi * (b - a), error_d = error(d);
+        }
+    }
+    return std::pow(10.0, (a + b) / 2);
+}
+
+// Local search: repeatedly tries to increase or decrease each weight by its
+// step size, keeping changes that reduce the error (by a minimum amount).
+// When a full pass over all weights brings no improvement, the step sizes are
+// halved, until they reach 0.
+EvalWeights FitWeights(const std::vector<Position> &positions, EvalWeights weights, double k, int threads) {
+    std::array<int, EVAL_TERM_COUNT> steps;
+    for (int i = 0; i < EVAL_TERM_COUNT; ++i) steps[i] = std::max(std::abs(weights[i]) / 8, 8);
+    double best_error = MeanSquaredError(positions, weights, k, threads);
+    std::cerr << "Initial error: " << best_error << '\n';
+    for (int pass = 0; pass < max_fit_passes; ++pass) {
+        bool improved = false;
+        for (int i = 0; i < EVAL_TERM_COUNT; ++i) {
+            if (steps[i] == 0) continue;
+            for (int sign : {1, -1}) {
+                EvalWeights candidate = weights;
+                candidate[i] += sign * steps[i];
+                double error = MeanSquaredError(positions, candidate, k, threads);
+                if (error < best_error - min_error_reduction) {
+                    weights = candidate;
+                    best_error = error;
+                    improved = true;
+                    break;
+                }
+            }
+        }
+        std::cerr << "Pass " << pass + 1 << ": error " << best_error << '\n';
+        if (!improved) {
+            bool any_steps = false;
+            for (int &step : steps) any_steps |= (step /= 2) > 0;
+            if (!any_steps) break;
+        }
+    }
+    return weights;
+}
+
+int Fit(const std::string &positions_path, const EvalWeights &initial_weights, int threads) {
+    std::optional<std::vector<Position>> positions = ReadPositions(positions_path);
+    if (!positions) {
+        std::cerr << "Failed to read positions from " << positions_path << '\n';
+        return 1;
+    }
+    std::cerr << "Positions: " << positions->size() << '\n';
+    double k = FitScale(*positions, initial_weights, threads);
+    std::cerr << "Scaling constant K: " << k << '\n';
+    EvalWeights weights = FitWeights(*positions, initial_weights, k, threads);
+    std::cout << "# Fitted to " << positions->size() << " positions with K=" << k
+        << ", error " << MeanSquaredError(*positions, weights, k, threads) << '\n';
+    WriteEvalWeights(std::cout, weights);
+    return 0;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        PrintUsage();
+        return 1;
+    }
+    std::string_view command = argv[1];
+    int threads = 1;
+    int argi = 2;
+    for (; argi < argc && std::string_view(argv[argi]).starts_with("--"); ++argi) {
+        std::string_view arg = argv[argi];
+        if (arg.starts_with("--threads=") && ParseInt(arg.substr(10), threads) && threads > 0) {
+            // threads parsed above
+        } else {
+            std::cerr << "Invalid option: " << arg << '\n';
+            return 1;
+        }
+    }
+    if (command == "selfplay" && argc - argi == 2) {
+        std::optional<PlayerDesc> desc = ParsePlayerDesc(argv[argi]);
+        if (!desc) {
+            std::cerr << "Failed to parse player type: " << argv[argi] << '\n';
+            return 1;
+        }
+        int games = 0;
+        if (!ParseInt(argv[argi + 1], games) || games < 1) {
+            std::cerr << "Invalid number of games: " << argv[argi + 1] << '\n';
+            return 1;
+        }
+        return SelfPlay(*desc, games, threads);
+    }
+    if (command == "fit" && (argc - argi == 1 || argc - argi == 2)) {
+        EvalWeights weights = default_eval_weights;
+        if (argc - argi == 2) {
+            if (auto loaded = LoadEvalWeights(argv[argi + 1]); !loaded) {
+                std::cerr << "Failed to load evaluation weights from " << argv[argi + 1] << '\n';
+                return 1;
+            } else {
+                weights = *loaded;
+            }
+        }
+        return Fit(argv[argi], weights, threads);
+    }
+    PrintUsage();
+    return 1;
+}
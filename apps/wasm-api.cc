@@ -141,6 +141,7 @@ EMSCRIPTEN_KEEPALIVE char *mytikas_choose_ai_turn(
     if (!player_desc) return nullptr;
 
     std::unique_ptr<GamePlayer> player(CreatePlayerFromDesc(*player_desc));
+    if (!player) return nullptr;
     auto turn = player->SelectTurn(*state);
     if (!turn) return nullptr;
 
@@ -0,0 +1,275 @@
+// Microbenchmarks for the engine's hot code paths.
+//
+// Each benchmark runs over the same corpus of midgame states, generated by
+// playing random games with a fixed seed, so results are comparable between
+// runs. To compare a change, save the results of both versions as JSON, e.g.:
+//
+//   engine_benchmark --benchmark_format=json --benchmark_out=before.json
+//
+// and compare them with tools/compare.py from the Google Benchmark sources.
+
+#include <benchmark/benchmark.h>
+
+#include "eval.h"
+#include "moves.h"
+#include "random.h"
+#include "state.h"
+
+#include <array>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int corpus_games = 50;
+constexpr int corpus_first_turn = 10;
+constexpr int corpus_last_turn = 60;
+constexpr int corpus_turn_interval = 5;
+
+// Returns a corpus of states that occur in the middle of random games, where
+// the game is not (almost) over. The result is the same on every call.
+const std::vector<State> &Corpus() {
+    static const std::vector<State> corpus = []{
+        std::vector<State> states;
+        std::mt19937 rng(12345);
+        std::vector<Turn> turns;
+        for (int game = 0; game < corpus_games; ++game) {
+            State state = State::InitialAllSummonable();
+            for (int n = 0; n <= corpus_last_turn && !state.IsAlmostOver(); ++n) {
+                if (n >= corpus_first_turn && n % corpus_turn_interval == 0) {
+                    states.push_back(state);
+                }
+                GenerateTurns(state, turns);
+                ExecuteTurn(state, turns[rng() % turns.size()]);
+            }
+        }
+        return states;
+    }();
+    return corpus;
+}
+
+// Returns all turns for all states in the corpus, as (state index, turn) pairs.
+const std::vector<std::pair<size_t, Turn>> &CorpusTurns() {
+    static const std::vector<std::pair<size_t, Turn>> turns = []{
+        std::vector<std::pair<size_t, Turn>> res;
+        const std::vector<State> &corpus = Corpus();
+        for (size_t i = 0; i < corpus.size(); ++i) {
+            for (const Turn &turn : GenerateTurns(corpus[i])) res.push_back({i, turn});
+        }
+        return res;
+    }();
+    return turns;
+}
+
+void BM_GenerateTurns(benchmark::State &bm) {
+    const std::vector<State> &corpus = Corpus();
+    std::vector<Turn> turns;
+    int64_t total_turns = 0;
+    for (auto _ : bm) {
+        for (const State &state : corpus) {
+            GenerateTurns(state, turns);
+            total_turns += turns.size();
+        }
+    }
+    bm.SetItemsProcessed(bm.iterations() * corpus.size());
+    bm.counters["turns_per_state"] = static_cast<double>(total_turns) / (bm.iterations() * corpus.size());
+}
+BENCHMARK(BM_GenerateTurns);
+
+void BM_SampleTurn(benchmark::State &bm) {
+    const std::vector<State> &corpus = Corpus();
+    rng_t rng(12345);
+    for (auto _ : bm) {
+        for (const State &state : corpus) {
+            benchmark::DoNotOptimize(SampleTurn(state, rng));
+        }
+    }
+    bm.SetItemsProcessed(bm.iterations() * corpus.size());
+}
+BENCHMARK(BM_SampleTurn);
+
+void BM_CanWinThisTurn(benchmark::State &bm) {
+    const std::vector<State> &corpus = Corpus();
+    for (auto _ : bm) {
+        for (const State &state : corpus) {
+            benchmark::DoNotOptimize(CanWinThisTurn(state));
+        }
+    }
+    bm.SetItemsProcessed(bm.iterations() * corpus.size());
+}
+BENCHMARK(BM_CanWinThisTurn);
+
+void BM_ExecuteTurn(benchmark::State &bm) {
+    const std::vector<State> &corpus = Corpus();
+    const auto &turns = CorpusTurns();
+    for (auto _ : bm) {
+        for (const auto &[i, turn] : turns) {
+            State state = corpus[i];
+            ExecuteTurn(state, turn);
+            benchmark::DoNotOptimize(state);
+        }
+    }
+    bm.SetItemsProcessed(bm.iterations() * turns.size());
+}
+BENCHMARK(BM_ExecuteTurn);
+
+// Same as above, but executes turns in place and undoes them afterwards, like
+// the minimax search does.
+void BM_ExecuteTurnWithUndo(benchmark::State &bm) {
+    std::vector<State> corpus = Corpus();
+    const auto &turns = CorpusTurns();
+    for (auto _ : bm) {
+        for (const auto &[i, turn] : turns) {
+            StateUndo undo;
+            ExecuteTurn(corpus[i], turn, undo);
+            benchmark::DoNotOptimize(corpus[i]);
+            UndoTurn(corpus[i], undo);
+        }
+    }
+    bm.SetItemsProcessed(bm.iterations() * turns.size());
+}
+BENCHMARK(BM_ExecuteTurnWithUndo);
+
+// Executes the first action of each turn of the given type. The state is
+// restored with State::Undo(), which is included in the measurement.
+void BM_ExecuteAction(benchmark::State &bm, Action::Type type) {
+    std::vector<State> corpus = Corpus();
+    std::vector<std::pair<size_t, Action>> actions;
+    for (const auto &[i, turn] : CorpusTurns()) {
+        if (turn.naction > 0 && turn.actions[0].type == type) actions.push_back({i, turn.actions[0]});
+    }
+    for (auto _ : bm) {
+        for (const auto &[i, action] : actions) {
+            State &state = corpus[i];
+            StateUndo undo;
+            state.StartRecording(undo);
+            ExecuteAction(state, action);
+            state.StopRecording();
+            benchmark::DoNotOptimize(state);
+            state.Undo(undo);
+        }
+    }
+    bm.SetItemsProcessed(bm.iterations() * actions.size());
+}
+BENCHMARK_CAPTURE(BM_ExecuteAction, SUMMON, Action::SUMMON);
+BENCHMARK_CAPTURE(BM_ExecuteAction, MOVE, Action::MOVE);
+BENCHMARK_CAPTURE(BM_ExecuteAction, ATTACK, Action::ATTACK);
+BENCHMARK_CAPTURE(BM_ExecuteAction, SPECIAL, Action::SPECIAL);
+
+// Moves each god of the next player to an adjacent empty field and back, which
+// exercises the aura updates in State::Move().
+void BM_StateMove(benchmark::State &bm) {
+    std::vector<State> corpus = Corpus();
+    struct Move { size_t i; God god; field_t src, dst; };
+    std::vector<Move> moves;
+    for (size_t i = 0; i < corpus.size(); ++i) {
+        const State &state = corpus[i];
+        const Player player = state.NextPlayer();
+        for (int g = 0; g < GOD_COUNT; ++g) {
+            field_t src = state.fi(player, AsGod(g));
+            if (src == -1) continue;
+            field_mask_t empty = StepMask(ALL8, src) & ~state.Occupied();
+            if (empty) moves.push_back(Move{i, AsGod(g), src, PopField(empty)});
+        }
+    }
+    for (auto _ : bm) {
+        for (const Move &move : moves) {
+            State &state = corpus[move.i];
+            state.Move(state.NextPlayer(), move.god, move.dst);
+            benchmark::DoNotOptimize(state);
+            state.Move(state.NextPlayer(), move.god, move.src);
+        }
+    }
+    bm.SetItemsProcessed(2 * bm.iterations() * moves.size());
+}
+BENCHMARK(BM_StateMove);
+
+void BM_StateEncode(benchmark::State &bm) {
+    const std::vector<State> &corpus = Corpus();
+    for (auto _ : bm) {
+        for (const State &state : corpus) {
+            std::string s = state.Encode();
+            benchmark::DoNotOptimize(s);
+        }
+    }
+    bm.SetItemsProcessed(bm.iterations() * corpus.size());
+}
+BENCHMARK(BM_StateEncode);
+
+void BM_StateDecode(benchmark::State &bm) {
+    std::vector<std::string> encoded;
+    for (const State &state : Corpus()) encoded.push_back(state.Encode());
+    for (auto _ : bm) {
+        for (const std::string &s : encoded) {
+            std::optional<State> state = State::Decode(s);
+            benchmark::DoNotOptimize(state);
+        }
+    }
+    bm.SetItemsProcessed(bm.iterations() * encoded.size());
+}
+BENCHMARK(BM_StateDecode);
+
+void BM_StateEncodeTo(benchmark::State &bm) {
+    const std::vector<State> &corpus = Corpus();
+    std::array<uint8_t, State::BINARY_SIZE> bytes;
+    for (auto _ : bm) {
+        for (const State &state : corpus) {
+            state.EncodeTo(bytes);
+            benchmark::DoNotOptimize(bytes);
+        }
+    }
+    bm.SetItemsProcessed(bm.iterations() * corpus.size());
+}
+BENCHMARK(BM_StateEncodeTo);
+
+void BM_StateDecodeFrom(benchmark::State &bm) {
+    std::vector<std::array<uint8_t, State::BINARY_SIZE>> encoded(Corpus().size());
+    for (size_t i = 0; i < encoded.size(); ++i) Corpus()[i].EncodeTo(encoded[i]);
+    for (auto _ : bm) {
+        for (const auto &bytes : encoded) {
+            std::optional<State> state = State::DecodeFrom(bytes);
+            benchmark::DoNotOptimize(state);
+        }
+    }
+    bm.SetItemsProcessed(bm.iterations() * encoded.size());
+}
+BENCHMARK(BM_StateDecodeFrom);
+
+void BM_TurnToString(benchmark::State &bm) {
+    const auto &turns = CorpusTurns();
+    for (auto _ : bm) {
+        for (const auto &[i, turn] : turns) {
+            std::string s = turn.ToString();
+            benchmark::DoNotOptimize(s);
+        }
+    }
+    bm.SetItemsProcessed(bm.iterations() * turns.size());
+}
+BENCHMARK(BM_TurnToString);
+
+void BM_TurnFromString(benchmark::State &bm) {
+    std::vector<std::string> strings;
+    for (const auto &[i, turn] : CorpusTurns()) strings.push_back(turn.ToString());
+    for (auto _ : bm) {
+        for (const std::string &s : strings) {
+            std::optional<Turn> turn = Turn::FromString(s);
+            benchmark::DoNotOptimize(turn);
+        }
+    }
+    bm.SetItemsProcessed(bm.iterations() * strings.size());
+}
+BENCHMARK(BM_TurnFromString);
+
+void BM_Evaluate(benchmark::State &bm) {
+    const std::vector<State> &corpus = Corpus();
+    for (auto _ : bm) {
+        for (const State &state : corpus) {
+            benchmark::DoNotOptimize(Evaluate(state, default_eval_weights));
+        }
+    }
+    bm.SetItemsProcessed(bm.iterations() * corpus.size());
+}
+BENCHMARK(BM_Evaluate);
+
+}  // namespace
@@ -0,0 +1,47 @@
+#ifndef BOOK_H_INCLUDED
+#define BOOK_H_INCLUDED
+
+#include "mapped_file.h"
+#include "moves.h"
+#include "state.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <utility>
+
+// Opening book: precalculated turns for the first few turns of the game,
+// found by deep offline searches (see apps/book.cc), so that players can skip
+// searching the same opening positions over and over.
+//
+// The book file is a header followed by fixed-size entries sorted by state
+// hash (see State::Hash()), so lookups are a binary search in the
+// memory-mapped file.
+class OpeningBook {
+public:
+    // Returns nullptr if the file cannot be read or is not a valid book.
+    static std::unique_ptr<OpeningBook> Open(const std::string &path);
+
+    // Number of states in the book.
+    size_t Size() const { return size; }
+
+    // Returns the book turn for the state, or nothing if the state is not in
+    // the book. The turn is checked against the turns that are valid in the
+    // state, to guard against hash collisions and outdated books.
+    std::optional<Turn> Lookup(const State &state) const;
+
+private:
+    OpeningBook(std::unique_ptr<MappedFile> file, size_t size) : file(std::move(file)), size(size) {}
+
+    std::unique_ptr<MappedFile> file;
+    size_t size;
+};
+
+// Writes a book with the given turn for each state hash, in the format read by
+// OpeningBook::Open(). Returns false if the file cannot be written.
+bool WriteOpeningBook(const std::string &path, std::span<const std::pair<uint64_t, Turn>> entries);
+
+#endif  // ndef BOOK_H_INCLUDED
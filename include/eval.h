@@ -0,0 +1,90 @@
+#ifndef EVAL_H_INCLUDED
+#define EVAL_H_INCLUDED
+
+#include "state.h"
+
+#include <array>
+#include <iostream>
+#include <optional>
+#include <string>
+
+// Terms of the static evaluation function. The value of each term is the
+// difference between the next player and the opponent:
+//
+//  - HP: sum of hit points of all gods (see EvalTerms)
+//  - GATE_PROXIMITY: sum of GateProximity() of all gods in play
+//  - GATE_THREATS: number of gods that can move onto the enemy gate (see
+//    GateThreats()); for the next player, this means an immediate win
+//  - CHAINED, DAMAGE_BOOST, SPEED_BOOST, SHIELDED: number of gods in play with
+//    the respective status effect
+//
+enum EvalTerm {
+    EVAL_HP,
+    EVAL_GATE_PROXIMITY,
+    EVAL_GATE_THREATS,
+    EVAL_CHAINED,
+    EVAL_DAMAGE_BOOST,
+    EVAL_SPEED_BOOST,
+    EVAL_SHIELDED,
+    EVAL_TERM_COUNT
+};
+
+// Names of the terms, as used in weights files.
+extern const char *const eval_term_names[EVAL_TERM_COUNT];
+
+using EvalFeatures = std::array<int, EVAL_TERM_COUNT>;
+using EvalWeights = std::array<int, EVAL_TERM_COUNT>;
+
+constexpr EvalWeights default_eval_weights = {
+    /* HP             */ 1000,
+    /* GATE_PROXIMITY */  100,
+    /* GATE_THREATS   */    0,
+    /* CHAINED        */    0,
+    /* DAMAGE_BOOST   */    0,
+    /* SPEED_BOOST    */    0,
+    /* SHIELDED       */    0,
+};
+
+// Same as the default weights, but with a penalty for chained gods. This
+// doesn't seem to have too noticable of an impact on playing strength.
+constexpr EvalWeights experiment_eval_weights = {
+    /* HP             */ 1000,
+    /* GATE_PROXIMITY */  100,
+    /* GATE_THREATS   */    0,
+    /* CHAINED        */  -10,
+    /* DAMAGE_BOOST   */    0,
+    /* SPEED_BOOST    */    0,
+    /* SHIELDED       */    0,
+};
+
+// Returns a heuristic value of the state from the perspective of the next
+// player, as used by the minimax player at the leaves of the search tree.
+// Higher is better for the next player.
+//
+// This is the sum of the features (see GetEvalFeatures()) multiplied by their
+// weights, but faster: it takes constant time unless the gate threat or status
+// effect terms have nonzero weights.
+int Evaluate(const State &state, const EvalWeights &weights);
+
+// Returns the values of all evaluation terms in the given state.
+EvalFeatures GetEvalFeatures(const State &state);
+
+// Reads weights from a text file, which contains one term per line, as the
+// name of the term followed by its weight, e.g.:
+//
+//   hp 1000
+//   gate_proximity 100
+//
+// Empty lines and lines starting with '#' are ignored. Terms that are not
+// listed keep their default weight. Returns nothing if the file contains
+// invalid lines or unknown terms.
+std::optional<EvalWeights> ParseEvalWeights(std::istream &is);
+
+// Same as above, but reads the given file. Returns nothing if the file cannot
+// be read.
+std::optional<EvalWeights> LoadEvalWeights(const std::string &path);
+
+// Writes weights in the format read by ParseEvalWeights().
+void WriteEvalWeights(std::ostream &os, const EvalWeights &weights);
+
+#endif  // ndef EVAL_H_INCLUDED
@@ -0,0 +1,32 @@
+#ifndef MAPPED_FILE_H_INCLUDED
+#define MAPPED_FILE_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+
+// Read-only memory mapping of a whole file, as used for tablebases (see
+// tablebase.h) and opening books (see book.h). Pages are loaded on demand and
+// shared between processes that map the same file.
+class MappedFile {
+public:
+    // Returns nullptr if the file cannot be opened or mapped, or is empty.
+    static std::unique_ptr<MappedFile> Open(const std::string &path);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    std::span<const uint8_t> Data() const { return {static_cast<const uint8_t *>(addr), size}; }
+
+private:
+    MappedFile(void *addr, size_t size) : addr(addr), size(size) {}
+
+    void *addr;
+    size_t size;
+};
+
+#endif  // ndef MAPPED_FILE_H_INCLUDED
@@ -1,6 +1,7 @@
 #ifndef MOVES_H_INCLUDED
 #define MOVES_H_INCLUDED
 
+#include "random.h"
 #include "state.h"
 
 #include <algorithm>
@@ -85,10 +86,156 @@ struct Turn {
 
 std::vector<Turn> GenerateTurns(const State &state);
 
+// Same as above, but writes the turns into `turns`, which is cleared first.
+// This allows the caller to reuse the buffer between calls, so that generating
+// turns does not allocate memory once the buffer has grown large enough.
+void GenerateTurns(const State &state, std::vector<Turn> &turns);
+
+// Set of state hashes (see State::Hash()), used to deduplicate turns.
+// The set can be reused between calls to avoid allocating memory.
+class StateHashSet {
+public:
+    void Clear();
+
+    // Adds the hash to the set. Returns true if it was not present before.
+    bool Insert(uint64_t hash);
+
+private:
+    void Grow();
+
+    // Open addressing with linear probing. 0 marks an empty slot, so hash
+    // value 0 is stored as 1 instead (a harmless collision in practice).
+    std::vector<uint64_t> table;
+    size_t size = 0;
+};
+
+// Same as GenerateTurns(), but omits turns that lead to the same state as an
+// earlier turn, such as Hermes attacking two targets in either order, or
+// Dionysus reaching the same field by different paths. States are compared by
+// their hashes only, so in theory a hash collision could drop a distinct turn.
+//
+// This reduces the branching factor for the AI without losing any strength.
+// The UI should use GenerateTurns() instead, so the user can enter any valid
+// turn.
+void GenerateUniqueTurns(const State &state, std::vector<Turn> &turns, StateHashSet &seen);
+
+// Returns a random turn, selected uniformly from the turns that GenerateTurns()
+// would return, but without storing them all, which makes it much faster than
+// generating all turns and selecting one. (Note that the distribution is
+// uniform over turns, not over resulting states, so states that can be reached
+// by several turns are more likely to be selected; see GenerateUniqueTurns().)
+//
+// This is intended for random playouts.
+Turn SampleTurn(const State &state, rng_t &rng);
+
+// Generates the same turns as GenerateTurns() in stages, ordered by how
+// promising they are likely to be for the player to move:
+//
+//  1. WINS: turns that move a god onto the opponent's gate
+//  2. KILLS: attacks that probably kill an enemy, including area attacks
+//     (estimated from the base damage and remaining hit points, ignoring
+//     Athena's shield; see AttackedEnemies())
+//  3. ATTACKS: other attacks
+//  4. MOVES: other moves, including Aphrodite's swaps
+//  5. SUMMONS: turns that start with a summon
+//
+// Turns are only generated when the stage they belong to is requested, so a
+// search that finds a cut-off early can skip generating the remaining turns:
+// attacks are generated in the KILLS stage (since kills can only be told
+// apart from other attacks after generating them), moves in the MOVES stage,
+// and summons last. The WINS stage only checks CanWinThisTurn(), and
+// generates all turns at once if some turn wins.
+//
+// Turns that are generated in a later stage than they belong to, e.g. turns
+// that start with a summon, are returned in the stage they were generated in,
+// sorted by stage within it. Turns generated early (see Contains()) are
+// returned in their own stage.
+//
+// The generator can be reused for different states to avoid allocating memory.
+class StagedTurnGenerator {
+public:
+    enum Stage { WINS, KILLS, ATTACKS, MOVES, SUMMONS, DONE };
+
+    // Starts generating turns for the given state. The state must remain
+    // unchanged whenever Next() is called.
+    //
+    // If the caller already knows that no turn wins (see CanWinThisTurn()),
+    // it can pass may_win=false to skip that check in the WINS stage.
+    void Reset(const State &state, bool may_win = true);
+
+    // Returns true if `turn` is one of the turns of the state, e.g. to check
+    // that a turn from a transposition table is legal before executing it.
+    // This generates all turns that start with the same kind of action (a
+    // summon, an attack, or a move), which Next() then returns as usual. Must
+    // be called before Next().
+    bool Contains(const Turn &turn);
+
+    // Writes the turns of the next non-empty stage into `turns`, which is
+    // cleared first. Returns false if there are no more turns.
+    bool Next(std::vector<Turn> &turns);
+
+    // Returns the stage of the turns returned by the last call to Next().
+    // (Turns of earlier stages may be included; see above.)
+    Stage LastStage() const { return static_cast<Stage>(stage - 1); }
+
+private:
+    // Turns are generated in groups, by the first action of the turn.
+    enum Group { ATTACK_GROUP, MOVE_GROUP, SUMMON_GROUP, GROUP_COUNT };
+
+    // Generates the turns of `group`, unless this was done already, and adds
+    // them to `by_stage`.
+    void GenerateGroup(Group group);
+
+    const State *state = nullptr;
+    int stage = DONE;
+    bool may_win = true;
+    bool any_turns = false;
+    bool generated_groups[GROUP_COUNT] = {};
+    std::vector<Turn> generated;
+    std::vector<Turn> by_stage[DONE];
+};
+
+// Determines the stage that `turn` belongs to (see StagedTurnGenerator),
+// except that turns that start with a summon are classified by their other
+// actions. The turn is classified by looking only at its actions and the
+// initial state, since executing it would be relatively expensive. Never
+// returns SUMMONS or DONE.
+StagedTurnGenerator::Stage ClassifyTurn(const State &state, const Turn &turn);
+
+// Returns the fields of the enemies that `action` may damage, if it is an
+// attack or Artemis' special ability: the target field, or all enemies in the
+// area of an area attack (Poseidon, Dionysus and Hades, whose attacks are
+// identified by the attacker's own field). Like ClassifyTurn(), this only
+// looks at the state before the turn, and ignores Athena's shield.
+field_mask_t AttackedEnemies(const State &state, const Action &action);
+
+// Returns the gods of `player` that can move onto the opponent's gate with a
+// single move in the given state (as if it were `player`'s turn), considering
+// movement directions and obstacles, Hermes' speed boost, Hades' chains, and
+// Dionysus jumping on enemies. Doesn't build any turns.
+god_mask_t GateThreats(const State &state, Player player);
+
+// Returns true if the next player has a turn that wins the game immediately,
+// i.e., if GenerateTurns() returns a turn that ends on the opponent's gate.
+//
+// This is much faster than generating all turns: it checks GateThreats() and
+// the gods that could be summoned and move in the same turn. Only if an enemy
+// occupies the opponent's gate, and one of the player's gods could possibly
+// reach it after killing that enemy (special rule 3), are turns generated.
+//
+// The game must not be over.
+bool CanWinThisTurn(const State &state);
+
 void ExecuteAction(State &state, const Action &action);
 void ExecuteActions(State &state, const Turn &turn);
 void ExecuteTurn(State &state, const Turn &turn);
 
+// Executes a turn like ExecuteTurn() above, while recording the changes in
+// `undo`, so that UndoTurn() can restore the original state afterwards. This
+// allows a search to execute turns on a single state instead of copying it.
+void ExecuteTurn(State &state, const Turn &turn, StateUndo &undo);
+void UndoTurn(State &state, const StateUndo &undo);
+
 std::ostream &operator<<(std::ostream &os, const Action &a);
 std::ostream &operator<<(std::ostream &os, const Turn &t);
 
@@ -108,10 +255,9 @@ std::istream &operator>>(std::istream &os, Turn &t);
 // efficient, but is important for the UI where the user may execute the attacks
 // in either order.
 //
-// Later, I may refactor this so that the AI only considers the canonical moves,
-// either by making this boolean a parameter of the turn generator, or by
-// filtering out inferior/duplicate moves in the AI logic. (Alternatively, I
-// could force the UI to canonicalize the turn, but it's slightly tricky.)
+// The AI uses GenerateUniqueTurns(), which filters out duplicate turns
+// regardless of this setting. (Alternatively, I could force the UI to
+// canonicalize the turn, but it's slightly tricky.)
 //
 // (This boolean is defined in the header so I can reference it in tests.)
 constexpr bool hermes_canonicalize_attacks = false;
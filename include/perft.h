@@ -0,0 +1,32 @@
+#ifndef PERFT_H_INCLUDED
+#define PERFT_H_INCLUDED
+
+#include "moves.h"
+#include "state.h"
+
+#include <cstdint>
+#include <vector>
+
+// Performance test ("perft") of the turn generator: counts the number of leaf
+// nodes of the turn tree of the given depth, where each node has one child per
+// turn returned by GenerateTurns().
+//
+// Finished games have no children, so they only count as leaves at depth 0.
+//
+// At depth 1, turns are counted without executing them ("bulk counting"), so
+// the count measures turn generation rather than turn execution.
+int64_t Perft(const State &state, int depth);
+
+struct PerftDivideResult {
+    Turn turn;
+    int64_t count;
+};
+
+// Same as Perft(), but returns the count for each turn at the root separately,
+// which is useful to find the turn where two implementations differ. Root
+// turns are distributed over `threads` threads.
+//
+// `depth` must be at least 1.
+std::vector<PerftDivideResult> PerftDivide(const State &state, int depth, int threads = 1);
+
+#endif  // ndef PERFT_H_INCLUDED
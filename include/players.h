@@ -4,6 +4,11 @@
 #include "state.h"
 #include "moves.h"
 
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
 class GamePlayer {
 public:
     virtual ~GamePlayer() {};
@@ -27,25 +32,56 @@ struct CliPlayerOpts {
 
 struct MinimaxPlayerOpts {
     int max_depth = 0;  // use default
+    int max_time_ms = 0;  // no time limit; if set, uses iterative deepening
+    int tt_mb = -1;  // transposition table size in megabytes; 0 to disable; -1 to use default
+    int threads = 1;  // number of search threads (see Searcher in minimax_player.cc)
+    std::string weights_file;  // evaluation weights (see eval.h); empty to use default
+    enum Ordering { SEARCH, HEURISTIC } ordering = SEARCH;  // move ordering (see minimax_player.cc)
+    bool pvs = false;  // principal variation search
+    int aspiration_window = 0;  // 0 to disable; only used with iterative deepening
+    bool shuffle_root = false;  // select a random best turn, without collecting all of them
+    bool qsearch = false;  // quiescence search at the leaves
+    int qsearch_depth = 0;  // maximum quiescence search depth; use default
+    bool null_move = false;  // null-move pruning
+    bool lmr = false;  // late-move reductions
+    std::string tablebase_file;  // endgame tablebase (see tablebase.h); empty to disable
+    std::string book_file;  // opening book (see book.h); empty to disable
     bool experiment = false;
     bool verbose = false;
 };
 
 struct MctsPlayerOpts {
+    int iterations = 0;  // use default
+    double exploration = -1;  // UCT exploration constant; negative to use default
+    enum Policy { RANDOM, HEAVY } policy = RANDOM;  // playout policy (see mcts_player.cc)
+    int threads = 1;  // number of threads that share the search tree
+    std::string tablebase_file;  // endgame tablebase (see tablebase.h); empty to disable
+    std::string book_file;  // opening book (see book.h); empty to disable
+    bool verbose = false;
 };
 
 struct PlayerDesc {
     PlayerType type;
-    union {
-        RandomPlayerOpts   random;
-        CliPlayerOpts      cli;
-        MinimaxPlayerOpts  minimax;
-        MctsPlayerOpts     mcts;
+
+    // Only the options for `type` are used.
+    struct {
+        RandomPlayerOpts   random  = {};
+        CliPlayerOpts      cli     = {};
+        MinimaxPlayerOpts  minimax = {};
+        MctsPlayerOpts     mcts    = {};
     } opts;
 };
 
 std::optional<PlayerDesc> ParsePlayerDesc(std::string_view sv);
 
+// Returns false if an evaluation weights file, tablebase or opening book in
+// the description cannot be read. An error is printed in that case. Unlike
+// CreatePlayerFromDesc(), this doesn't allocate any search state.
+bool ValidatePlayerDesc(const PlayerDesc &desc);
+
+// Returns nullptr if the player cannot be created, for example because an
+// evaluation weights file, tablebase or opening book cannot be read. An error
+// is printed in that case.
 GamePlayer *CreatePlayerFromDesc(const PlayerDesc &desc);
 
 GamePlayer *CreateRandomPlayer(const RandomPlayerOpts &opts);
@@ -53,4 +89,15 @@ GamePlayer *CreateCliPlayer(const CliPlayerOpts &opts);
 GamePlayer *CreateMinimaxPlayer(const MinimaxPlayerOpts &opts);
 GamePlayer *CreateMctsPlayer(const MctsPlayerOpts &opts);
 
+struct MinimaxSearchResult {
+    int value;  // minimax value from the perspective of the next player
+    std::vector<Turn> best_turns;  // optimal turns; only one with shuffle_root
+};
+
+// Searches `state` once, the same way a player created by CreateMinimaxPlayer()
+// would, but with a new transposition table and without helper threads or an
+// opening book. This allows comparing search options, e.g. in tests. Returns
+// nothing if the player could not be created.
+std::optional<MinimaxSearchResult> SearchMinimax(const MinimaxPlayerOpts &opts, const State &state);
+
 #endif  // ndef PLAYERS_H_INCLUDED
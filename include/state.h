@@ -1,6 +1,10 @@
 #ifndef STATE_H_INCLUDED
 #define STATE_H_INCLUDED
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <compare>
 #include <cassert>
 #include <cstdint>
 #include <cstdlib>
@@ -8,6 +12,7 @@
 #include <span>
 #include <string>
 #include <string_view>
+#include <utility>
 
 enum Player : uint8_t {
     LIGHT = 0,
@@ -61,6 +66,29 @@ extern const char *field_names[FIELD_COUNT];
 
 constexpr field_t gate_index[2] = {0, FIELD_COUNT - 1};
 
+// Bitmask of fields, where bit i is set if field i is included. This allows
+// sets of fields (e.g. all fields occupied by a player) to be represented as
+// a single 64-bit integer.
+using field_mask_t = uint64_t;
+
+static_assert(FIELD_COUNT <= 64);
+
+constexpr field_mask_t FieldMask(field_t i) { return field_mask_t{1} << i; }
+
+constexpr field_mask_t ALL_FIELDS = (field_mask_t{1} << FIELD_COUNT) - 1;
+
+// Removes the lowest field from a nonempty mask and returns its index. This
+// makes it easy to iterate over the fields in a mask in ascending order:
+//
+//  while (mask) { field_t field = PopField(mask); ... }
+//
+inline field_t PopField(field_mask_t &mask) {
+    assert(mask != 0);
+    field_t field = std::countr_zero(mask);
+    mask &= mask - 1;
+    return field;
+}
+
 extern const field_t neighbors_data[];
 extern const size_t neighbors_index[FIELD_COUNT + 1];
 
@@ -71,37 +99,6 @@ inline std::span<const field_t> Neighbors(field_t field) {
         &neighbors_data[neighbors_index[field + 1]]);
 }
 
-// Computes the difference between old and new neighbors when moving
-// from field `src` to `dst`.
-//
-// For each field f that was a neighbor of src but is not a neighbor of dst,
-// excluding dst itself, on_old(f) is called.
-//
-// For each field g that is a neighbor of dst but not a neighbor of src,
-// excluding src itself, on_new(g) is called.
-//
-// (This is used to update status effects when pieces move.)
-template<typename T, typename U>
-void NeighborsDiff(field_t src, field_t dst, T on_old, U on_new) {
-    std::span<const field_t> src_nbs = Neighbors(src);
-    std::span<const field_t> dst_nbs = Neighbors(dst);
-    size_t i = 0, j = 0;
-    for (;;) {
-        field_t f = i < src_nbs.size() ? src_nbs[i] : FIELD_COUNT;
-        field_t g = j < dst_nbs.size() ? dst_nbs[j] : FIELD_COUNT;
-        if (f < g) {
-            if (f != dst) on_old(f);
-            ++i;
-        } else if (f > g) {
-            if (g != src) on_new(g);
-            ++j;
-        } else {  // f == g
-            if (f == FIELD_COUNT) break;
-            ++i, ++j;
-        }
-    }
-}
-
 inline bool OnBoard(int r, int c) {
     return abs(r - 4) + abs(c - 4) <= 4;
 }
@@ -156,6 +153,18 @@ struct Dir {
     int8_t dc;
 };
 
+// Directions are identified by their index in the list returned by
+// GetDirs(ALL8), where the orthogonal directions come first, followed by the
+// diagonal directions.
+constexpr int DIR_COUNT = 8;
+constexpr int DIR_RIGHT = 1;
+constexpr int DIR_LEFT  = 2;
+
+// Bitmask of directions that visit fields in increasing order of index. Since
+// fields are numbered in row-major order, these are the directions that point
+// up, or right along the same row. (Checked by a static_assert in state.cc.)
+constexpr uint8_t ascending_dirs = 0b11001010;
+
 enum God : uint8_t {
     ZEUS,        //  0
     HEPHAESTUS,  //  1
@@ -196,6 +205,98 @@ enum Dirs : uint8_t {
 
 std::span<const Dir> GetDirs(Dirs);
 
+// Precalculated bitmasks used for move and attack generation. Use the accessor
+// functions below instead of accessing these directly.
+struct BoardMasks {
+    field_mask_t step[KNIGHT + 1][FIELD_COUNT];
+    field_mask_t ray[DIR_COUNT][FIELD_COUNT];
+    field_mask_t distance[BOARD_SIZE][FIELD_COUNT];
+    field_mask_t row_range[BOARD_SIZE][BOARD_SIZE];
+    field_mask_t col_range[BOARD_SIZE][BOARD_SIZE];
+};
+
+extern const BoardMasks board_masks;
+
+// Returns the fields that can be reached from `field` by taking a single step
+// in one of the given directions. (The DIRECT flag is ignored.)
+inline field_mask_t StepMask(Dirs dirs, field_t field) {
+    return board_masks.step[dirs & 7][field];
+}
+
+// Returns the range [begin, end) of direction indices (as defined by DIR_COUNT)
+// included in the given direction set. Only valid for ORTHOGONAL, DIAGONAL and
+// ALL8 directions (the DIRECT flag is ignored).
+inline std::pair<int, int> DirRange(Dirs dirs) {
+    switch (dirs & 7) {
+    case Dirs::ORTHOGONAL: return {0, 4};
+    case Dirs::DIAGONAL:   return {4, 8};
+    case Dirs::ALL8:       return {0, 8};
+    default:
+        assert(false);
+        return {0, 0};
+    }
+}
+
+// Returns the fields reachable from `field` by moving in a straight line in the
+// direction with index `dir`, excluding `field` itself.
+inline field_mask_t RayMask(int dir, field_t field) {
+    return board_masks.ray[dir][field];
+}
+
+// Returns the fields at most `dist` steps away from `field` in any of the eight
+// directions (i.e., within a square centered at `field`).
+inline field_mask_t DistanceMask(field_t field, int dist) {
+    return board_masks.distance[std::min(dist, BOARD_SIZE - 1)][field];
+}
+
+// Returns the field in `mask` that is closest to the start of a ray with the
+// given direction. `mask` must be a nonempty subset of the ray.
+inline field_t FirstOnRay(int dir, field_mask_t mask) {
+    assert(mask != 0);
+    return (ascending_dirs >> dir) & 1
+        ? std::countr_zero(mask)
+        : 63 - std::countl_zero(mask);
+}
+
+// Returns the fields along a ray from `field` in direction `dir`, up to and
+// including the first field in `blockers`, but at most `dist` steps away.
+inline field_mask_t RayMaskUntil(int dir, field_t field, int dist, field_mask_t blockers) {
+    field_mask_t ray = RayMask(dir, field) & DistanceMask(field, dist);
+    if (field_mask_t hit = ray & blockers) {
+        ray &= ~RayMask(dir, FirstOnRay(dir, hit));
+    }
+    return ray;
+}
+
+// Returns the fields with coordinates (r, c) where r1 <= r <= r2 and
+// c1 <= c <= c2. All coordinates must be between 0 and BOARD_SIZE (exclusive).
+inline field_mask_t RectMask(int r1, int c1, int r2, int c2) {
+    if (r1 > r2 || c1 > c2) return 0;
+    return board_masks.row_range[r1][r2] & board_masks.col_range[c1][c2];
+}
+
+// Computes the difference between old and new neighbors when moving
+// from field `src` to `dst`.
+//
+// For each field f that was a neighbor of src but is not a neighbor of dst,
+// excluding dst itself, on_old(f) is called.
+//
+// For each field g that is a neighbor of dst but not a neighbor of src,
+// excluding src itself, on_new(g) is called.
+//
+// (This is used to update status effects when pieces move.)
+template<typename T, typename U>
+void NeighborsDiff(field_t src, field_t dst, T on_old, U on_new) {
+    const field_mask_t src_nbs = StepMask(ALL8, src);
+    const field_mask_t dst_nbs = StepMask(ALL8, dst);
+    for (field_mask_t mask = src_nbs & ~dst_nbs & ~FieldMask(dst); mask; ) {
+        on_old(PopField(mask));
+    }
+    for (field_mask_t mask = dst_nbs & ~src_nbs & ~FieldMask(src); mask; ) {
+        on_new(PopField(mask));
+    }
+}
+
 enum StatusFx : uint8_t {
     UNAFFECTED   = 0,
     CHAINED      = 1,  // Chained by enemy Hades
@@ -204,6 +305,9 @@ enum StatusFx : uint8_t {
     SHIELDED     = 8,  // Protected by Athena's shield
 };
 
+// Maximum hit points of any god (see pantheon).
+constexpr int MAX_HIT_POINTS = 10;
+
 struct GodInfo {
     char name[16];
     char ascii_id;
@@ -252,6 +356,64 @@ constexpr FieldState FieldState::UNOCCUPIED = FieldState{
     .god = (God)0,
 };
 
+// Returns 10 minus the Manhattan distance from `field` to the opponent's gate,
+// which is used as a positional evaluation term for a god of `player` at that
+// field. (This is negative for fields far away from the opponent's gate.)
+inline int GateProximity(Player player, field_t field) {
+    auto [r1, c1] = FieldCoords(field);
+    auto [r2, c2] = FieldCoords(gate_index[Other(player)]);
+    return 10 - (abs(r1 - r2) + abs(c1 - c2));
+}
+
+// Evaluation terms that are maintained incrementally by State, so that the
+// static evaluation function (see eval.h) doesn't have to iterate over all
+// gods. Both terms are indexed by player.
+struct EvalTerms {
+    int hp[2];              // sum of hit points of all gods (dead gods have 0)
+    int gate_proximity[2];  // sum of GateProximity() of all gods in play
+
+    auto operator<=>(const EvalTerms&) const = default;
+};
+
+// Holds the information needed to revert changes made to a State, so that a
+// search can execute and undo turns on a single state instead of copying the
+// state for each child. See State::StartRecording() for details.
+//
+// The state of each god is saved the first time it is modified, which covers
+// all changes to hit points, positions and status effects (including kills,
+// moves, knockbacks and chains). The remaining fields are small, so they are
+// saved unconditionally.
+struct StateUndo {
+    uint32_t   saved_gods;          // bit (player*GOD_COUNT + god) is set if saved
+    GodState   gods[2][GOD_COUNT];  // only valid for gods in `saved_gods`
+    god_mask_t summonable[2];
+    Player     player;
+    uint64_t   hash;
+    EvalTerms  eval_terms;
+};
+
+// Random keys used to calculate the Zobrist hash of a state (see State::Hash()).
+// These are generated deterministically, so hash values are stable between
+// runs, and can be stored in files.
+struct ZobristKeys {
+    uint64_t field[2][GOD_COUNT][FIELD_COUNT];
+    uint64_t hp[2][GOD_COUNT][MAX_HIT_POINTS + 1];
+    uint64_t chained[2][GOD_COUNT];
+    uint64_t summonable[2][GOD_COUNT];
+    uint64_t dark_to_move;
+};
+
+extern const ZobristKeys zobrist_keys;
+
+// When set to true, State::Hash() verifies that the incrementally updated hash
+// matches the hash calculated from scratch. This is slow, so it should only be
+// enabled for debugging.
+constexpr bool debug_hash = false;
+
+// When set to true, State::GetEvalTerms() verifies that the incrementally
+// updated terms match the terms calculated from scratch.
+constexpr bool debug_eval_terms = false;
+
 class State {
 public:
     // Returns a start state where all gods are summonable.
@@ -275,6 +437,41 @@ public:
     // restore states easily, and share them for testing purposes.
     std::string Encode() const;
 
+    // Size of the binary encoding produced by EncodeTo().
+    static constexpr size_t BINARY_SIZE = 32;
+
+    // Encodes the state in a fixed-size binary format, which contains the
+    // same information as Encode(), without allocating memory.
+    void EncodeTo(std::span<uint8_t, BINARY_SIZE> out) const;
+
+    // Decodes the bytes produced by EncodeTo(). Returns nothing if the input
+    // is invalid.
+    static std::optional<State> DecodeFrom(std::span<const uint8_t, BINARY_SIZE> in);
+
+    // Returns a 64-bit Zobrist hash of the state, which is updated incrementally
+    // whenever the state changes. States that compare equal have equal hashes.
+    //
+    // Only the CHAINED status effect is included, since the other status
+    // effects are determined by the positions of the gods.
+    uint64_t Hash() const {
+        assert(!debug_hash || hash == ComputeHash());
+        return hash;
+    }
+
+    // Calculates the hash from scratch. Mostly intended for debugging/testing.
+    uint64_t ComputeHash() const;
+
+    // Returns the evaluation terms, which are updated incrementally whenever
+    // the state changes, so this takes constant time.
+    const EvalTerms &GetEvalTerms() const {
+        assert(!debug_eval_terms || eval_terms == ComputeEvalTerms());
+        return eval_terms;
+    }
+
+    // Calculates the evaluation terms from scratch. Mostly intended for
+    // debugging/testing.
+    EvalTerms ComputeEvalTerms() const;
+
     // Access for properties of gods in play.
     int hp(Player player, God god) const { return gods[player][god].hp; }
     int fi(Player player, God god) const { return gods[player][god].fi; }
@@ -287,6 +484,10 @@ public:
 
     god_mask_t Summonable(Player player) const { return summonable[player]; }
 
+    // Bitmasks of the fields occupied by either player, or a specific player.
+    field_mask_t Occupied() const               { return occupied[LIGHT] | occupied[DARK]; }
+    field_mask_t Occupied(Player player) const  { return occupied[player]; }
+
     bool IsEmpty(field_t i) const       { return !IsOccupied(i); }
     bool IsOccupied(field_t i) const    { return fields[i].occupied; }
     int PlayerAt(field_t i) const       { return fields[i].occupied ? fields[i].player : -1; }
@@ -363,8 +564,31 @@ public:
 
     void EndTurn() {
         player = Other(player);
+        hash ^= zobrist_keys.dark_to_move;
+    }
+
+    // Starts recording changes made to this state in `undo`, until
+    // StopRecording() is called. Afterwards, Undo(undo) restores the state to
+    // how it was when recording started. Only one recording can be active at a
+    // time, and it is not copied along with the state.
+    void StartRecording(StateUndo &undo) {
+        assert(recorder.undo == nullptr);
+        undo.saved_gods = 0;
+        undo.summonable[LIGHT] = summonable[LIGHT];
+        undo.summonable[DARK]  = summonable[DARK];
+        undo.player = player;
+        undo.hash = hash;
+        undo.eval_terms = eval_terms;
+        recorder.undo = &undo;
+    }
+
+    void StopRecording() {
+        assert(recorder.undo != nullptr);
+        recorder.undo = nullptr;
     }
 
+    void Undo(const StateUndo &undo);
+
     // Mostly intended for debugging/testing.
     auto operator<=>(const State &) const = default;
 
@@ -381,19 +605,62 @@ private:
     void Remove(Player player, God god, field_t field);
 
     void AddFx(Player player, God god, StatusFx new_fx) {
-        StatusFx &fx = gods[player][god].fx;
-        fx = static_cast<StatusFx>(fx | new_fx);
+        SetFx(player, god, static_cast<StatusFx>(fx(player, god) | new_fx));
     }
 
     void RemoveFx(Player player, God god, StatusFx old_fx) {
-        StatusFx &fx = gods[player][god].fx;
-        fx = static_cast<StatusFx>(fx & ~old_fx);
+        SetFx(player, god, static_cast<StatusFx>(fx(player, god) & ~old_fx));
+    }
+
+    void SetFx(Player player, God god, StatusFx new_fx) {
+        StatusFx &fx = MutableGod(player, god).fx;
+        if ((fx ^ new_fx) & CHAINED) hash ^= zobrist_keys.chained[player][god];
+        fx = new_fx;
+    }
+
+    void SetHp(Player player, God god, int new_hp) {
+        uint8_t &hp = MutableGod(player, god).hp;
+        hash ^= zobrist_keys.hp[player][god][hp] ^ zobrist_keys.hp[player][god][new_hp];
+        eval_terms.hp[player] += new_hp - hp;
+        hp = new_hp;
+    }
+
+    // All changes to gods must go through this method, so they are recorded
+    // when recording is active.
+    GodState &MutableGod(Player player, God god) {
+        if (StateUndo *undo = recorder.undo) {
+            uint32_t bit = uint32_t{1} << ((int) player*GOD_COUNT + (int) god);
+            if ((undo->saved_gods & bit) == 0) {
+                undo->saved_gods |= bit;
+                undo->gods[player][god] = gods[player][god];
+            }
+        }
+        return gods[player][god];
     }
 
+    // Points to the undo record while recording. This is not copied along with
+    // the state, and does not affect comparisons.
+    struct Recorder {
+        StateUndo *undo = nullptr;
+
+        Recorder() = default;
+        Recorder(const Recorder &) {}
+        Recorder &operator=(const Recorder &) { return *this; }
+
+        bool operator==(const Recorder &) const { return true; }
+        std::strong_ordering operator<=>(const Recorder &) const { return std::strong_ordering::equal; }
+    };
+
+    static_assert(2*GOD_COUNT <= 32);
+
     Player      player;
     god_mask_t  summonable[2];
     GodState    gods[2][GOD_COUNT];
     FieldState  fields[FIELD_COUNT];
+    field_mask_t occupied[2];  // kept in sync with `fields`
+    uint64_t    hash;          // see Hash()
+    EvalTerms   eval_terms;    // see GetEvalTerms()
+    Recorder    recorder;
 };
 
 std::ostream &operator<<(std::ostream &os, const State::DebugPrint &dbg);
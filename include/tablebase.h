@@ -0,0 +1,88 @@
+#ifndef TABLEBASE_H_INCLUDED
+#define TABLEBASE_H_INCLUDED
+
+#include "mapped_file.h"
+#include "state.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Endgame tablebases: the exact outcome of every position with only a few gods
+// in play and no gods left to summon, calculated by retrograde analysis (see
+// GenerateTablebase() and apps/tbgen.cc).
+//
+// Positions are grouped by material, the set of gods each player has in play,
+// with one table per material. A table stores one byte per position, indexed
+// by the next player and the field, hit points and chained status of each god.
+// Other status effects follow from the positions of the gods.
+
+// The gods each player has in play.
+struct Material {
+    god_mask_t gods[2];
+
+    static Material Of(const State &state);
+
+    // Parses a material written as the ASCII ids (see GodInfo) of the light
+    // gods, a slash, and the ASCII ids of the dark gods, e.g. "ZH/S".
+    static std::optional<Material> Parse(std::string_view sv);
+
+    // Returns the material in the format read by Parse().
+    std::string ToString() const;
+
+    // Total number of gods in play.
+    int Count() const;
+
+    uint32_t Key() const { return gods[LIGHT] | uint32_t{gods[DARK]} << 16; }
+
+    auto operator<=>(const Material &) const = default;
+};
+
+// Outcome of a position from the perspective of the next player.
+struct TablebaseResult {
+    int outcome;  // 1 if the next player wins, -1 if they lose, 0 for a draw
+    int turns;    // number of turns until the game is won (0 for a draw)
+
+    auto operator<=>(const TablebaseResult &) const = default;
+};
+
+// Read-only tablebase, memory-mapped from a file written by
+// GenerateTablebase(). Safe to share between threads.
+class Tablebase {
+public:
+    // Returns nullptr if the file cannot be read or is not a valid tablebase.
+    static std::unique_ptr<Tablebase> Open(const std::string &path);
+
+    // Maximum number of gods in play over all tables.
+    int MaxGods() const { return max_gods; }
+
+    // Returns the outcome of the state, or nothing if the state is not covered
+    // by any table: if either player has gods left to summon, or if there is
+    // no table for its material. The game must not be over already.
+    std::optional<TablebaseResult> Probe(const State &state) const;
+
+private:
+    explicit Tablebase(std::unique_ptr<MappedFile> file) : file(std::move(file)) {}
+
+    std::unique_ptr<MappedFile> file;
+    int max_gods = 0;
+    std::unordered_map<uint32_t, std::span<const uint8_t>> tables;  // by Material::Key()
+};
+
+// Calculates tables for the given materials, and all materials they can turn
+// into when gods are killed, and writes them to the given file. Progress is
+// printed to `log`, if it is not null.
+//
+// Generation time and memory grow with the number of positions, which is
+// exponential in the number of gods; materials with more than 2 or 3 gods are
+// not practical. Returns false, and prints an error, if a table is too large
+// to generate or the file cannot be written.
+bool GenerateTablebase(std::span<const Material> materials, const std::string &path, std::ostream *log);
+
+#endif  // ndef TABLEBASE_H_INCLUDED
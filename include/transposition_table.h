@@ -0,0 +1,88 @@
+#ifndef TRANSPOSITION_TABLE_H_INCLUDED
+#define TRANSPOSITION_TABLE_H_INCLUDED
+
+#include "moves.h"
+#include "state.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Describes how the stored score relates to the true value of a state:
+//
+//  EXACT: score is the exact value
+//  LOWER: score is a lower bound (search failed high)
+//  UPPER: score is an upper bound (search failed low)
+//
+enum class Bound : uint8_t { NONE, UPPER, LOWER, EXACT };
+
+struct TranspositionEntry {
+    int   score;
+    int   depth;
+    Bound bound;
+    Turn  best_turn;  // naction == 0 if there is no best turn
+};
+
+// Fixed-size hash table that maps state hashes (see State::Hash()) to search
+// results. Entries are grouped into buckets that fit in a single cache line,
+// so that a probe touches only one cache line.
+//
+// When a bucket is full, entries from previous searches are replaced first,
+// and otherwise the entry with the lowest search depth.
+//
+// The table can be shared between threads without locking. Each entry is
+// stored in three 64-bit words, where the first word is the key XOR-ed with
+// the other two. If two threads write the same entry concurrently, a reader
+// may see words from different writes, but then the key won't match, so the
+// entry is simply ignored.
+class TranspositionTable {
+public:
+    // Creates a table that uses at most `size_mb` megabytes of memory. If
+    // size_mb is 0, the table is disabled: Probe() never finds anything and
+    // Store() does nothing.
+    explicit TranspositionTable(size_t size_mb);
+
+    bool Enabled() const { return bucket_count > 0; }
+
+    // Should be called before starting a new search, so that entries from
+    // previous searches are preferred for replacement. Must not be called
+    // while other threads are using the table.
+    void NewSearch() { generation = (generation + 1) % max_generation; }
+
+    // Removes all entries. Must not be called while other threads are using
+    // the table.
+    void Clear();
+
+    // Looks up the entry for the given key. Returns true and fills in `entry`
+    // if it is found.
+    bool Probe(uint64_t key, TranspositionEntry &entry) const;
+
+    // Stores a search result. `best_turn` may be nullptr if no best turn is
+    // known, in which case the previous best turn for the same key is kept.
+    void Store(uint64_t key, int depth, Bound bound, int score, const Turn *best_turn);
+
+private:
+    static constexpr int BUCKET_SIZE = 2;
+    static constexpr int max_generation = 64;
+
+    struct Slot {
+        std::atomic<uint64_t> check;  // key ^ data ^ turn
+        std::atomic<uint64_t> data;   // score, depth, bound, generation, last action
+        std::atomic<uint64_t> turn;   // first five actions
+    };
+
+    struct alignas(64) Bucket {
+        Slot slots[BUCKET_SIZE];
+    };
+
+    static_assert(sizeof(Bucket) == 64);
+
+    Bucket &BucketFor(uint64_t key) const { return buckets[key & (bucket_count - 1)]; }
+
+    size_t bucket_count = 0;  // a power of 2
+    std::unique_ptr<Bucket[]> buckets;
+    int generation = 0;
+};
+
+#endif  // ndef TRANSPOSITION_TABLE_H_INCLUDED
@@ -0,0 +1,106 @@
+#include "book.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace {
+
+// File layout: a FileHeader, followed by `entry_count` Entries sorted by hash.
+// All integers are stored in native byte order.
+constexpr char file_magic[8] = {'M', 'Y', 'T', 'K', 'B', 'O', 'O', 'K'};
+constexpr uint32_t file_version = 1;
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_count;
+};
+
+// Each action is packed into 16 bits: 2 bits for the type, 4 bits for the
+// god and 6 bits for the field (as in the transposition table).
+struct Entry {
+    uint64_t hash;
+    uint16_t naction;
+    uint16_t actions[Turn::MAX_ACTION];
+    uint16_t reserved;
+};
+
+static_assert(sizeof(FileHeader) == 16);
+static_assert(sizeof(Entry) == 24);
+static_assert(FIELD_COUNT <= 64);
+static_assert(GOD_COUNT <= 16);
+
+uint16_t PackAction(const Action &action) {
+    return (action.type << 10) | (action.god << 6) | action.field;
+}
+
+Action UnpackAction(uint16_t bits) {
+    return Action{
+        .type  = static_cast<Action::Type>((bits >> 10) & 3),
+        .god   = static_cast<God>((bits >> 6) & 15),
+        .field = static_cast<field_t>(bits & 63),
+    };
+}
+
+}  // namespace
+
+std::unique_ptr<OpeningBook> OpeningBook::Open(const std::string &path) {
+    std::unique_ptr<MappedFile> file = MappedFile::Open(path);
+    if (!file) return nullptr;
+    const std::span<const uint8_t> data = file->Data();
+    if (data.size() < sizeof(FileHeader)) return nullptr;
+    FileHeader header;
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (std::memcmp(header.magic, file_magic, sizeof(file_magic)) != 0 ||
+            header.version != file_version ||
+            data.size() != sizeof(FileHeader) + size_t{header.entry_count} * sizeof(Entry)) {
+        return nullptr;
+    }
+    return std::unique_ptr<OpeningBook>(new OpeningBook(std::move(file), header.entry_count));
+}
+
+std::optional<Turn> OpeningBook::Lookup(const State &state) const {
+    // The mapping is page-aligned, and entries start at a multiple of 8 bytes.
+    const Entry *begin = reinterpret_cast<const Entry *>(file->Data().data() + sizeof(FileHeader));
+    const Entry *end = begin + size;
+    const uint64_t hash = state.Hash();
+    const Entry *it = std::lower_bound(begin, end, hash,
+            [](const Entry &entry, uint64_t hash) { return entry.hash < hash; });
+    if (it == end || it->hash != hash || it->naction > Turn::MAX_ACTION) return {};
+
+    Turn turn = {};
+    turn.naction = it->naction;
+    for (int i = 0; i < turn.naction; ++i) turn.actions[i] = UnpackAction(it->actions[i]);
+    std::vector<Turn> turns = GenerateTurns(state);
+    if (std::find(turns.begin(), turns.end(), turn) == turns.end()) return {};
+    return turn;
+}
+
+bool WriteOpeningBook(const std::string &path, std::span<const std::pair<uint64_t, Turn>> entries) {
+    std::vector<Entry> sorted;
+    sorted.reserve(entries.size());
+    for (const auto &[hash, turn] : entries) {
+        Entry entry = {};
+        entry.hash = hash;
+        entry.naction = turn.naction;
+        for (int i = 0; i < turn.naction; ++i) entry.actions[i] = PackAction(turn.actions[i]);
+        sorted.push_back(entry);
+    }
+    // Keep the first entry for each hash.
+    std::stable_sort(sorted.begin(), sorted.end(),
+            [](const Entry &a, const Entry &b) { return a.hash < b.hash; });
+    sorted.erase(std::unique(sorted.begin(), sorted.end(),
+            [](const Entry &a, const Entry &b) { return a.hash == b.hash; }), sorted.end());
+
+    std::ofstream ofs(path, std::ios::binary);
+    if (!ofs) return false;
+    FileHeader header = {};
+    std::memcpy(header.magic, file_magic, sizeof(file_magic));
+    header.version = file_version;
+    header.entry_count = sorted.size();
+    ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    ofs.write(reinterpret_cast<const char *>(sorted.data()), sorted.size() * sizeof(Entry));
+    return bool(ofs.flush());
+}
@@ -0,0 +1,122 @@
+// Static evaluation function used by the minimax player.
+
+#include "eval.h"
+
+#include "moves.h"
+
+#include <bit>
+#include <fstream>
+#include <sstream>
+#include <string_view>
+
+const char *const eval_term_names[EVAL_TERM_COUNT] = {
+    "hp",
+    "gate_proximity",
+    "gate_threats",
+    "chained",
+    "damage_boost",
+    "speed_boost",
+    "shielded",
+};
+
+namespace {
+
+constexpr StatusFx status_fx_terms[] = {CHAINED, DAMAGE_BOOST, SPEED_BOOST, SHIELDED};
+
+static_assert(EVAL_CHAINED + std::size(status_fx_terms) == EVAL_TERM_COUNT);
+
+// Adds the status effect terms to `features`. Unlike the other terms, these
+// are not maintained incrementally, so this iterates over all gods.
+void AddStatusFxFeatures(const State &state, EvalFeatures &features) {
+    const Player player = state.NextPlayer();
+    for (int p = 0; p < 2; ++p) {
+        const int sign = p == player ? 1 : -1;
+        for (int g = 0; g < GOD_COUNT; ++g) {
+            if (state.fi(AsPlayer(p), AsGod(g)) == -1) continue;
+            StatusFx fx = state.fx(AsPlayer(p), AsGod(g));
+            for (size_t i = 0; i < std::size(status_fx_terms); ++i) {
+                if (fx & status_fx_terms[i]) features[EVAL_CHAINED + i] += sign;
+            }
+        }
+    }
+}
+
+// Returns the GATE_THREATS term.
+int GateThreatsFeature(const State &state) {
+    const Player player = state.NextPlayer();
+    return std::popcount(GateThreats(state, player)) - std::popcount(GateThreats(state, Other(player)));
+}
+
+}  // namespace
+
+int Evaluate(const State &state, const EvalWeights &weights) {
+    // Very simplistic. The HP and gate proximity terms are maintained
+    // incrementally by State (see State::GetEvalTerms()).
+    //
+    // TODO: instead of absolute HP diff, we should probably use relative
+    // diff, to avoid cases where one player is clearly leading but unwilling
+    // to lose e.g. 4 HP to kill a 3 HP enemy because it will make the absolute
+    // score go down.
+    //
+    // Note: gate proximity isn't a great metric for Hera (who may be swapped
+    // off the main diagonals) and Dionysus; I should fix this later. It
+    // intrinsically values having gods in play, too, since only gods in play
+    // contribute.
+    const Player player = state.NextPlayer();
+    const Player opponent = Other(player);
+    const EvalTerms &terms = state.GetEvalTerms();
+    int score =
+        weights[EVAL_HP] * (terms.hp[player] - terms.hp[opponent]) +
+        weights[EVAL_GATE_PROXIMITY] * (terms.gate_proximity[player] - terms.gate_proximity[opponent]);
+    if (weights[EVAL_GATE_THREATS] != 0) score += weights[EVAL_GATE_THREATS] * GateThreatsFeature(state);
+    bool status_fx_terms_used = false;
+    for (int i = EVAL_CHAINED; i < EVAL_TERM_COUNT; ++i) status_fx_terms_used |= weights[i] != 0;
+    if (status_fx_terms_used) {
+        EvalFeatures features = {};
+        AddStatusFxFeatures(state, features);
+        for (int i = EVAL_CHAINED; i < EVAL_TERM_COUNT; ++i) score += weights[i] * features[i];
+    }
+    return score;
+}
+
+EvalFeatures GetEvalFeatures(const State &state) {
+    const Player player = state.NextPlayer();
+    const Player opponent = Other(player);
+    const EvalTerms &terms = state.GetEvalTerms();
+    EvalFeatures features = {};
+    features[EVAL_HP] = terms.hp[player] - terms.hp[opponent];
+    features[EVAL_GATE_PROXIMITY] = terms.gate_proximity[player] - terms.gate_proximity[opponent];
+    features[EVAL_GATE_THREATS] = GateThreatsFeature(state);
+    AddStatusFxFeatures(state, features);
+    return features;
+}
+
+std::optional<EvalWeights> ParseEvalWeights(std::istream &is) {
+    EvalWeights weights = default_eval_weights;
+    std::string line;
+    while (std::getline(is, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream iss(line);
+        std::string name;
+        int weight;
+        if (!(iss >> name >> weight)) return {};
+        if (iss >> std::ws; !iss.eof()) return {};  // trailing data
+        int i = 0;
+        while (i < EVAL_TERM_COUNT && name != eval_term_names[i]) ++i;
+        if (i == EVAL_TERM_COUNT) return {};  // unknown term
+        weights[i] = weight;
+    }
+    return weights;
+}
+
+std::optional<EvalWeights> LoadEvalWeights(const std::string &path) {
+    std::ifstream ifs(path);
+    if (!ifs) return {};
+    return ParseEvalWeights(ifs);
+}
+
+void WriteEvalWeights(std::ostream &os, const EvalWeights &weights) {
+    for (int i = 0; i < EVAL_TERM_COUNT; ++i) {
+        os << eval_term_names[i] << ' ' << weights[i] << '\n';
+    }
+}
@@ -0,0 +1,25 @@
+#include "mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+std::unique_ptr<MappedFile> MappedFile::Open(const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) return nullptr;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return nullptr;
+    }
+    size_t size = st.st_size;
+    void *addr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);  // the mapping remains valid
+    if (addr == MAP_FAILED) return nullptr;
+    return std::unique_ptr<MappedFile>(new MappedFile(addr, size));
+}
+
+MappedFile::~MappedFile() {
+    munmap(addr, size);
+}
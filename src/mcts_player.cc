@@ -1,75 +1,351 @@
-// Implements an AI player based on Monte Carlo Tree Search.
+// Implements an AI player based on Monte Carlo Tree Search, using the UCT
+// (Upper Confidence bounds applied to Trees) selection rule.
 //
-// NOTE: current implementation applies Monte Carlo simulations only, it does
-// not build a search tree at all.
+// Each iteration consists of four steps:
+//
+//  1. Selection: starting from the root, repeatedly select the child that
+//     maximizes the UCB1 value, until we reach a node that is not expanded.
+//  2. Expansion: create children for the selected node (if the game is not
+//     over yet), and select one of them.
+//  3. Simulation: play turns from the selected node until the game is (almost)
+//     over, either randomly or according to a simple heuristic (the playout
+//     policy).
+//  4. Backpropagation: update the statistics of all nodes on the path from
+//     the root to the selected node with the outcome of the simulation.
+//
+// After all iterations, the most visited child of the root is selected.
+//
+// Iterations can run on multiple threads, which share a single search tree
+// ("tree parallelization"). See Node for how concurrent updates are handled.
 
+#include "book.h"
 #include "moves.h"
 #include "players.h"
 #include "random.h"
 #include "state.h"
+#include "tablebase.h"
 
+#include <atomic>
+#include <algorithm>
 #include <cassert>
-
+#include <cmath>
+#include <cstdint>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <vector>
 
 namespace {
 
-constexpr int playouts_per_node = 100;
+constexpr int default_iterations = 10000;
+constexpr double default_exploration = 1.4;  // approximately sqrt(2)
+
+// Weights used by the heavy playout policy (see SelectHeavyTurn()).
+constexpr int heavy_kill_weight          = 32;
+constexpr int heavy_attack_weight        =  8;
+constexpr int heavy_move_weight          =  4;
+constexpr int heavy_near_gate_distance   =  2;
+constexpr int heavy_near_gate_factor     =  2;  // for attacks on enemies near our gate
+constexpr int heavy_next_to_zeus_divisor =  4;  // for moves next to the enemy Zeus
+
+// Selects a turn for the heavy playout policy, using only cheap checks on the
+// turns' actions rather than executing them:
+//
+//  - A turn that wins immediately is always selected.
+//  - Otherwise, a turn is selected randomly, weighted by the kind of turn:
+//    kills are preferred over other attacks, which are preferred over other
+//    turns. Attacks on enemies near our gate get a higher weight, and turns
+//    that move a god next to the enemy Zeus get a lower weight.
+//
+// `turns` and `weights` are scratch buffers.
+Turn SelectHeavyTurn(const State &state, rng_t &rng, std::vector<Turn> &turns, std::vector<int> &weights) {
+    const Player player = state.NextPlayer();
+    const Player opponent = Other(player);
+    const field_t zeus_field = state.fi(opponent, ZEUS);
+    const field_mask_t next_to_zeus = zeus_field == -1 ? 0 : StepMask(ALL8, zeus_field);
+    const field_mask_t near_gate = DistanceMask(gate_index[player], heavy_near_gate_distance);
+
+    GenerateTurns(state, turns);
+    weights.clear();
+    int total_weight = 0;
+    for (const Turn &turn : turns) {
+        StagedTurnGenerator::Stage stage = ClassifyTurn(state, turn);
+        if (stage == StagedTurnGenerator::WINS) return turn;
+        int weight =
+            stage == StagedTurnGenerator::KILLS ? heavy_kill_weight :
+            stage == StagedTurnGenerator::ATTACKS ? heavy_attack_weight :
+            heavy_move_weight;
+        for (int i = 0; i < turn.naction; ++i) {
+            const Action &action = turn.actions[i];
+            field_mask_t mask = FieldMask(action.field);
+            if (action.type == Action::ATTACK && (near_gate & mask) && state.PlayerAt(action.field) == opponent) {
+                weight *= heavy_near_gate_factor;
+            }
+            if (action.type == Action::MOVE && (next_to_zeus & mask)) {
+                weight = std::max(weight / heavy_next_to_zeus_divisor, 1);
+            }
+        }
+        weights.push_back(weight);
+        total_weight += weight;
+    }
+    int r = std::uniform_int_distribution<int>(0, total_weight - 1)(rng);
+    for (size_t i = 0; i < turns.size(); ++i) {
+        r -= weights[i];
+        if (r < 0) return turns[i];
+    }
+    assert(false);
+    return turns.back();
+}
 
-void PlayOutRandomly(State &state, rng_t &rng) {
+// Plays turns until the game is over, according to the given policy, and
+// returns the winner (or -1 for a tie, see State::AlmostWinner()). With the
+// random policy, turns are sampled uniformly without generating the full
+// list of turns (see SampleTurn()). `turns` and `weights` are scratch buffers
+// for the heavy policy.
+//
+// The playout ends early when the next player can win immediately (see
+// CanWinThisTurn()), assuming that the player would take the win, or when the
+// outcome can be looked up in the tablebase (if not null).
+int PlayOut(State &state, MctsPlayerOpts::Policy policy, const Tablebase *tablebase, rng_t &rng,
+        std::vector<Turn> &turns, std::vector<int> &weights) {
     while (!state.IsAlmostOver()) {
-        std::vector<Turn> turns = GenerateTurns(state);
-        assert(!turns.empty());
-        ExecuteTurn(state, Choose(rng, turns));
+        if (CanWinThisTurn(state)) return state.NextPlayer();
+        if (tablebase) {
+            if (auto result = tablebase->Probe(state)) {
+                return result->outcome > 0 ? state.NextPlayer() : result->outcome < 0 ? Other(state.NextPlayer()) : -1;
+            }
+        }
+        switch (policy) {
+            case MctsPlayerOpts::RANDOM:
+                ExecuteTurn(state, SampleTurn(state, rng));
+                break;
+            case MctsPlayerOpts::HEAVY:
+                ExecuteTurn(state, SelectHeavyTurn(state, rng, turns, weights));
+                break;
+        }
     }
+    return state.AlmostWinner();
 }
 
-int FinalScore(Player player, const State &state) {
-    int w = state.AlmostWinner();
-    return w == player ? 2 : w == -1 ? 1 : 0;
+// Returns twice the final score for `player`: 2 if the game was won by
+// `player`, 0 if it was lost, or 1 if it ended in a tie. Scores are doubled so
+// they can be accumulated in integer counters.
+uint32_t FinalScore2(Player player, int winner) {
+    return winner == player ? 2 : winner == -1 ? 1 : 0;
 }
 
+// Node of the search tree, which is shared between all worker threads.
+//
+// Statistics are updated with atomic operations. When a thread descends into
+// a node, it increments `visits` immediately, but adds the score only after
+// the simulation has finished. In the mean time, the visit counts as a loss
+// ("virtual loss"), which discourages other threads from selecting the same
+// path.
+//
+// Only one thread expands a node: the thread that changes `expansion` from
+// UNEXPANDED to EXPANDING. Other threads treat the node as a leaf until it
+// becomes EXPANDED, after which `children` and `child_count` are immutable.
+struct Node {
+    enum Expansion : uint8_t { UNEXPANDED, EXPANDING, EXPANDED };
+
+    // Turn that leads from the parent to this node.
+    Turn turn;
+
+    // Number of simulations that passed through this node (including the
+    // ones still in progress), and twice the sum of their scores from the
+    // perspective of the player who executed `turn` (i.e., the player to move
+    // in the parent node).
+    std::atomic<uint32_t> visits;
+    std::atomic<uint64_t> score2;
+
+    std::atomic<Expansion> expansion;
+    uint32_t child_count;
+    std::unique_ptr<Node[]> children;
+
+    bool IsExpanded() const { return expansion.load(std::memory_order_acquire) == EXPANDED; }
+};
+
+// Per-thread state. Each worker uses its own random number generator and
+// scratch buffers, so workers only interact through the search tree.
+struct Worker {
+    rng_t rng = InitializeRng();
+    State state;
+    std::vector<Node*> path;
+    std::vector<Turn> turns;
+    std::vector<int> playout_weights;
+    StateHashSet seen_states;
+};
+
 }  // namespace
 
 class MctsPlayer : public GamePlayer {
 public:
-    MctsPlayer(): rng(InitializeRng()) {}
+    MctsPlayer(int iterations, double exploration, MctsPlayerOpts::Policy policy,
+            std::unique_ptr<Tablebase> tablebase, std::unique_ptr<OpeningBook> book, int threads, bool verbose) :
+            iterations(iterations),
+            exploration(exploration),
+            policy(policy),
+            tablebase(std::move(tablebase)),
+            book(std::move(book)),
+            verbose(verbose),
+            workers(threads) {}
+
     std::optional<Turn> SelectTurn(const State &state) override;
 
 private:
-    std::mt19937_64 rng;
+    // Runs search iterations until `iterations` have been started (by all
+    // workers combined).
+    void Work(Worker &worker, const State &root_state);
+
+    // Returns the child of `parent` with the highest UCB1 value.
+    Node *SelectChild(const Node &parent) const;
+
+    // Creates children for the given node, one for each unique turn. Returns
+    // false if another thread is expanding the node concurrently.
+    bool Expand(Node &node, Worker &worker);
+
+    int iterations;
+    double exploration;
+    MctsPlayerOpts::Policy policy;
+    std::unique_ptr<Tablebase> tablebase;  // null if disabled
+    std::unique_ptr<OpeningBook> book;  // null if disabled
+    bool verbose;
+
+    // Search tree of the current call to SelectTurn().
+    std::unique_ptr<Node> root;
+
+    std::vector<Worker> workers;
+    std::atomic<int> next_iteration;
+    std::atomic<size_t> node_count;
 };
 
-std::optional<Turn> MctsPlayer::SelectTurn(const State &state) {
-    std::optional<Turn> best_turn;
-    const Player player = state.NextPlayer();
-    const std::vector<Turn> turns = GenerateTurns(state);
-    const int samples = 100;
-    int min_wins = 2*samples + 1;
-    int max_wins = -1;
-    for (const Turn &turn : turns) {
-        State next_state = state;
-        ExecuteTurn(next_state, turn);
-        int wins = 0;
-        for (int n = 0; n < samples; ++n) {
-            State final_state = next_state;
-            PlayOutRandomly(final_state, rng);
-            wins += FinalScore(player, final_state);
+Node *MctsPlayer::SelectChild(const Node &parent) const {
+    assert(parent.IsExpanded() && parent.child_count > 0);
+    const double log_visits = std::log(std::max(parent.visits.load(std::memory_order_relaxed), 1u));
+    Node *best = nullptr;
+    double best_ucb = -std::numeric_limits<double>::infinity();
+    for (uint32_t i = 0; i < parent.child_count; ++i) {
+        Node &child = parent.children[i];
+        uint32_t visits = child.visits.load(std::memory_order_relaxed);
+        if (visits == 0) return &child;  // always try unvisited children first
+        double value = child.score2.load(std::memory_order_relaxed) / 2.0;
+        double ucb = value / visits + exploration * std::sqrt(log_visits / visits);
+        if (ucb > best_ucb) {
+            best_ucb = ucb;
+            best = &child;
         }
-        if (wins < min_wins) {
-            min_wins = wins;
+    }
+    return best;
+}
+
+bool MctsPlayer::Expand(Node &node, Worker &worker) {
+    Node::Expansion expected = Node::UNEXPANDED;
+    if (!node.expansion.compare_exchange_strong(expected, Node::EXPANDING, std::memory_order_acquire)) {
+        return expected == Node::EXPANDED;
+    }
+    GenerateUniqueTurns(worker.state, worker.turns, worker.seen_states);
+    assert(!worker.turns.empty());
+    node.children.reset(new Node[worker.turns.size()]());
+    node.child_count = worker.turns.size();
+    for (uint32_t i = 0; i < node.child_count; ++i) node.children[i].turn = worker.turns[i];
+    node_count.fetch_add(node.child_count, std::memory_order_relaxed);
+    node.expansion.store(Node::EXPANDED, std::memory_order_release);
+    return true;
+}
+
+void MctsPlayer::Work(Worker &worker, const State &root_state) {
+    const Player player = root_state.NextPlayer();
+    while (next_iteration.fetch_add(1, std::memory_order_relaxed) < iterations) {
+        State &state = worker.state;
+        state = root_state;
+        worker.path.clear();
+
+        // Selection. Visits are counted on the way down (see Node).
+        Node *node = root.get();
+        uint32_t previous_visits = node->visits.fetch_add(1, std::memory_order_relaxed);
+        worker.path.push_back(node);
+        while (!state.IsAlmostOver()) {
+            // Expansion. Nodes are only expanded on their second visit, which
+            // keeps the tree small, since most leaf nodes are visited only
+            // once.
+            if (!node->IsExpanded() && (previous_visits == 0 || !Expand(*node, worker))) break;
+            node = SelectChild(*node);
+            ExecuteTurn(state, node->turn);
+            previous_visits = node->visits.fetch_add(1, std::memory_order_relaxed);
+            worker.path.push_back(node);
         }
-        if (wins > max_wins) {
-            max_wins = wins;
-            best_turn = turn;
+
+        // Simulation
+        int winner = PlayOut(state, policy, tablebase.get(), worker.rng, worker.turns, worker.playout_weights);
+
+        // Backpropagation. The score of each node is from the perspective of
+        // the player who moved into it, which alternates along the path.
+        uint32_t score2 = FinalScore2(player, winner);
+        for (size_t i = 0; i < worker.path.size(); ++i) {
+            // Node at depth i was entered by the root player if i is odd.
+            worker.path[i]->score2.fetch_add(i % 2 == 1 ? score2 : 2 - score2, std::memory_order_relaxed);
         }
     }
-    std::cerr << "min_wins=" << min_wins << " max_wins=" << max_wins;
-    if (best_turn) std::cerr << " best_turn=" << *best_turn;
-    std::cerr << '\n';
-    return best_turn;
 }
 
-GamePlayer *CreateMctsPlayer(const MctsPlayerOpts &) {
-    return new MctsPlayer();
+std::optional<Turn> MctsPlayer::SelectTurn(const State &root_state) {
+    if (book) {
+        if (std::optional<Turn> turn = book->Lookup(root_state)) {
+            if (verbose) std::cerr << "Book turn: " << *turn << '\n';
+            return turn;
+        }
+    }
+
+    root.reset(new Node());
+    node_count = 1;
+    workers[0].state = root_state;
+    Expand(*root, workers[0]);
+    if (root->child_count == 1) return root->children[0].turn;  // only one choice
+
+    next_iteration = 0;
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < workers.size(); ++i) {
+        threads.emplace_back([this, &root_state, i]() { Work(workers[i], root_state); });
+    }
+    Work(workers[0], root_state);
+    for (std::thread &thread : threads) thread.join();
+
+    const Node *best = nullptr;
+    for (uint32_t i = 0; i < root->child_count; ++i) {
+        const Node &child = root->children[i];
+        if (best == nullptr || child.visits > best->visits) best = &child;
+    }
+    assert(best != nullptr);
+    if (verbose) {
+        uint32_t visits = best->visits;
+        std::cerr << "MCTS iterations: " << iterations << " threads: " << workers.size()
+            << " nodes: " << node_count << " best_turn=" << best->turn << " visits=" << visits
+            << " value=" << best->score2 / 2.0 / std::max(visits, 1u) << '\n';
+    }
+    return best->turn;
+}
+
+GamePlayer *CreateMctsPlayer(const MctsPlayerOpts &opts) {
+    int iterations = opts.iterations > 0 ? opts.iterations : default_iterations;
+    double exploration = opts.exploration >= 0 ? opts.exploration : default_exploration;
+    int threads = opts.threads > 0 ? opts.threads : 1;
+    std::unique_ptr<Tablebase> tablebase;
+    if (!opts.tablebase_file.empty()) {
+        tablebase = Tablebase::Open(opts.tablebase_file);
+        if (!tablebase) {
+            std::cerr << "Failed to open tablebase " << opts.tablebase_file << '\n';
+            return nullptr;
+        }
+    }
+    std::unique_ptr<OpeningBook> book;
+    if (!opts.book_file.empty()) {
+        book = OpeningBook::Open(opts.book_file);
+        if (!book) {
+            std::cerr << "Failed to open opening book " << opts.book_file << '\n';
+            return nullptr;
+        }
+    }
+    return new MctsPlayer(iterations, exploration, opts.policy, std::move(tablebase), std::move(book),
+            threads, opts.verbose);
 }
@@ -1,84 +1,354 @@
 // Implements an AI player based on Minimax search with alpha/beta-pruning
 // and move ordering heuristic.
 
+#include "book.h"
+#include "eval.h"
 #include "moves.h"
 #include "players.h"
 #include "random.h"
 #include "state.h"
+#include "tablebase.h"
+#include "transposition_table.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <iostream>
+#include <memory>
+#include <thread>
 
 namespace {
 
 constexpr int default_max_search_depth = 4;
+constexpr int default_tt_mb = 16;
+constexpr int default_qsearch_depth = 4;
+
+// Maximum search depth used with iterative deepening, if only a time limit
+// is given. In practice, the time limit is reached much earlier.
+constexpr int max_iterative_search_depth = 100;
+
+// Number of nodes searched between checks of the deadline (or stop flag).
+constexpr int deadline_check_interval = 1024;
+
+// Number of killer turns remembered per ply (see Searcher::OrderTurns()).
+constexpr int killers_per_ply = 2;
+
+// Null-move pruning: the depth of the null-move search is reduced by this
+// much, in addition to the ply of the null move itself.
+constexpr int null_move_reduction = 2;
+constexpr int null_move_min_depth = 3;
+
+// Late-move reductions: quiet turns that are ordered after the first few
+// turns are first searched with this much reduced depth.
+constexpr int lmr_reduction = 1;
+constexpr int lmr_min_depth = 3;
+constexpr int lmr_min_turn_index = 3;
+
 constexpr int inf = 999999999;
 constexpr int win = 100000000;
 
-int Evaluate(const State &state, bool experiment) {
-    // Very simplistic:
-    int score[2] = {0, 0};
-    for (int p = 0; p < 2; ++p) {
-        for (int g = 0; g < GOD_COUNT; ++g) {
-            Player player = AsPlayer(p);
-            God god = AsGod(g);
-
-            // Score HP remaining
-            //
-            // TODO: instead of absolute diff, we should probably use relative
-            // diff, to avoid cases where one player is clearly leading but
-            // unwilling to lose e.g. 4 HP to kill a 3 HP enemy because it will
-            // make the absolute score go down.
-            score[p] += state.hp(player, god) * 1000;
-
-            field_t field = state.fi(player, god);
-            if (field != -1) {
-                // Score distance to enemy's gate. Note: this isn't a great
-                // metric for Hera (who may be swapped off the main diagonals)
-                // and Dionysus; I should fix this later.
-                //
-                // Note that this intrinsically values having gods in play,
-                // too, since only if field != -1 is the bonus applied.
-                auto [r1, c1] = FieldCoords(field);
-                auto [r2, c2] = FieldCoords(gate_index[1 - p]);
-                int dist = abs(r1 - r2) + abs(c1 - c2);
-                score[p] += 100*(10 - dist);
-
-                if (experiment) {
-                    // Score auras. This doesn't seem to have too noticable of
-                    // an impact on playing strength.
-                    StatusFx fx = state.fx(player, god);
-                    if (fx & CHAINED) score[p] -= 10;
-                    // if (fx & DAMAGE_BOOST)  score[p] +=  1;
-                    // if (fx & SPEED_BOOST)   score[p] +=  3;
-                    // if (fx & SHIELDED)      score[p] +=  5;
+// Win/loss scores depend on the remaining search depth (see Search()), so they
+// are converted to be relative to the current node before storing them in the
+// transposition table, and converted back when they are retrieved. This way,
+// the scores remain correct when the same state is found at a different depth.
+int ScoreToTable(int score, int depth_left) {
+    return score > win/2 ? score - depth_left : score < -win/2 ? score + depth_left : score;
+}
+
+int ScoreFromTable(int score, int depth_left) {
+    return score > win/2 ? score + depth_left : score < -win/2 ? score - depth_left : score;
+}
+
+// Converts the outcome of a tablebase probe into a search value, which is the
+// same value that a search to the end of the game would return (see
+// Searcher::Search()).
+int TablebaseValue(const TablebaseResult &result, int depth_left) {
+    int value = win + depth_left - result.turns - default_max_search_depth;
+    return result.outcome > 0 ? value : result.outcome < 0 ? -value : 0;
+}
+
+// A turn with its value, and its position before sorting (see SortByValue()).
+struct ScoredTurn {
+    int value;
+    int index;
+    Turn turn;
+};
+
+// Sorts turns by decreasing value. Turns with equal values keep their order,
+// like with std::stable_sort(), which would allocate memory.
+void SortByValue(std::vector<ScoredTurn> &turns) {
+    for (size_t i = 0; i < turns.size(); ++i) turns[i].index = i;
+    std::sort(turns.begin(), turns.end(), [](const ScoredTurn &a, const ScoredTurn &b) {
+        return a.value != b.value ? a.value > b.value : a.index < b.index;
+    });
+}
+
+// Moves `turn` to the front of `turns`, if it occurs in the list, while
+// preserving the order of the other turns.
+void MoveToFront(std::vector<Turn> &turns, const Turn &turn) {
+    auto it = std::find(turns.begin(), turns.end(), turn);
+    if (it != turns.end()) std::rotate(turns.begin(), it, it + 1);
+}
+
+// Returns true if `turn` should be searched by the quiescence search (see
+// Searcher::Quiesce()): turns that win or kill, attacks on damaged gods
+// (anywhere in the area of an area attack), and moves that bring a god within
+// reach of the enemy gate. Like ClassifyTurn(),
+// this looks only at the actions of the turn. Reach is estimated from the
+// base movement speed, ignoring obstacles and movement directions.
+bool IsQuiescenceTurn(const State &state, const Turn &turn) {
+    const Player player = state.NextPlayer();
+    const Player opponent = Other(player);
+    switch (ClassifyTurn(state, turn)) {
+        case StagedTurnGenerator::WINS:
+        case StagedTurnGenerator::KILLS:
+            return true;
+
+        case StagedTurnGenerator::ATTACKS:
+            for (int i = 0; i < turn.naction; ++i) {
+                const Action &action = turn.actions[i];
+                bool attack = action.type == Action::ATTACK ||
+                    (action.type == Action::SPECIAL && action.god == ARTEMIS);
+                if (!attack) continue;
+                for (field_mask_t targets = AttackedEnemies(state, action); targets; ) {
+                    God god = AsGod(state.GodAt(PopField(targets)));
+                    if (state.hp(opponent, god) < pantheon[god].hit) return true;
                 }
             }
-        }
+            return false;
+
+        case StagedTurnGenerator::MOVES:
+            for (int i = 0; i < turn.naction; ++i) {
+                const Action &action = turn.actions[i];
+                if (action.type != Action::MOVE) continue;
+                // Dionysus jumps like a knight, which covers distance 2.
+                int reach = action.god == DIONYSUS ? 2 : pantheon[action.god].mov;
+                field_mask_t threatened = DistanceMask(gate_index[opponent], reach);
+                field_t src = state.fi(player, action.god);
+                if ((threatened & FieldMask(action.field)) && (src == -1 || !(threatened & FieldMask(src)))) {
+                    return true;
+                }
+            }
+            return false;
+
+        default:
+            return false;
     }
-    Player player = state.NextPlayer();
-    Player opponent = Other(player);
-    return score[player] - score[opponent];
 }
 
-int Search(const State &state, int depth_left, int alpha, int beta, bool experiment);
+// Options that affect the search, shared by all searchers of a player.
+struct SearchOptions {
+    EvalWeights weights;
+    MinimaxPlayerOpts::Ordering ordering;
+    bool pvs;
+    int aspiration_window;  // 0 if disabled
+    bool shuffle_root;
+    int qsearch_depth;  // 0 if disabled
+    bool null_move;
+    bool lmr;
+    std::shared_ptr<const Tablebase> tablebase;  // null if disabled
+};
+
+// Holds the scratch buffers used during search. Buffers are indexed by ply
+// (distance from the root) and reused between searches, so that searching does
+// not allocate memory once the buffers have grown to their working size.
+//
+// Multiple searchers can search the same state concurrently in different
+// threads, sharing a transposition table ("Lazy SMP"). Only the main searcher
+// determines the result; helper searchers only fill the transposition table,
+// which speeds up the main search.
+class Searcher {
+public:
+    using clock = std::chrono::steady_clock;
+
+    // If `stop` is not null, the search is aborted when it becomes true.
+    Searcher(const SearchOptions &options, TranspositionTable &tt, const std::atomic<bool> *stop = nullptr) :
+            options(options), stop(stop), tt(tt), rng(InitializeRng()) {}
+
+    // Searches the game tree up to `max_depth`, and returns the minimax value,
+    // and the optimal turns in `best_turns`.
+    //
+    // Normally, all turns with the optimal value are returned. With the
+    // shuffle_root option, the root turns are shuffled and only the first
+    // optimal turn is returned, which is a random choice among the optimal
+    // turns (though not necessarily a uniform one, since turns are reordered
+    // between iterations), while allowing more pruning at the root.
+    //
+    // With the aspiration_window option, each iteration after the first is
+    // searched with a window around the value of the previous iteration, and
+    // searched again with a full window if the value falls outside of it.
+    //
+    // If a deadline is given, this uses iterative deepening: the tree is
+    // searched at depth 1, 2, 3, etc. until `max_depth` is reached or the
+    // deadline passes. An iteration that is interrupted by the deadline is
+    // discarded, so the result is that of the last completed iteration. The
+    // first iteration is always completed, even if it exceeds the deadline.
+    //
+    // The depth of the last completed iteration is returned in `depth_reached`.
+    int FindBestTurns(
+            const State &state, int max_depth, std::optional<clock::time_point> deadline,
+            std::vector<Turn> &best_turns, int &depth_reached);
+
+    // Searches the given state with iterative deepening, up to `max_depth`,
+    // until the stop flag is set, only to fill the transposition table.
+    //
+    // Different helpers start at different depths and search the root turns
+    // in different orders, so that they are less likely to search exactly the
+    // same nodes at the same time.
+    void Help(const State &state, int max_depth, int helper_index);
+
+    // Number of nodes searched since the last call to FindBestTurns() or
+    // Help().
+    int64_t Nodes() const { return nodes; }
+
+private:
+    struct PlyBuffers {
+        std::vector<Turn> turns;
+        std::vector<ScoredTurn> scored_turns;
+        StagedTurnGenerator generator;
+        StateHashSet seen;
+
+        // Turns that recently caused a beta cut-off at this ply, most recent
+        // first. Unused entries have naction == 0.
+        Turn killers[killers_per_ply];
+
+        // Whether this ply was reached by a null move (see Search()).
+        bool null_move = false;
+    };
+
+    // Orders turns by the values of a shallower search (ordering=search).
+    void ReorderMoves(State &state, std::vector<Turn> &turns, int depth, int ply);
+
+    // Orders turns using heuristics that don't require searching
+    // (ordering=heuristic): first the hash turn, then killer turns, then the
+    // remaining turns by their history scores.
+    void OrderTurns(const State &state, std::vector<Turn> &turns, int ply, const std::optional<Turn> &hash_turn);
+
+    // Returns the history score of a turn, which is the sum of the scores of
+    // its actions.
+    int HistoryScore(Player player, const Turn &turn) const;
 
-void ReorderMoves(const State &state, std::vector<Turn> &turns, int depth, bool experiment) {
+    // Updates the killer turns and history table after `turn` caused a beta
+    // cut-off.
+    void RecordCutoff(Player player, const Turn &turn, int depth_left, int ply);
+
+    int SearchRoot(State &state, int depth, int alpha, int beta, std::vector<Turn> &best_turns);
+
+    int Search(State &state, int depth_left, int ply, int alpha, int beta);
+
+    // Quiescence search, called by Search() at depth 0 (if enabled) so that
+    // leaves are not evaluated in the middle of an exchange. Only turns
+    // selected by IsQuiescenceTurn() are searched, and the player to move may
+    // instead "stand pat", accepting the static evaluation. `depth_left` is 0
+    // or negative, and is bounded by -qsearch_depth.
+    int Quiesce(State &state, int depth_left, int ply, int alpha, int beta);
+
+    // Returns true if the search should be aborted, because the deadline has
+    // passed or the stop flag is set. Once this returns true, it keeps
+    // returning true until the next call to FindBestTurns() or Help().
+    bool Aborted();
+
+    void StartSearch(const State &state, int max_depth);
+
+    const SearchOptions &options;
+    const std::atomic<bool> *stop;
+
+    // Deadline for the current search iteration, if any.
+    std::optional<clock::time_point> deadline;
+    bool aborted = false;
+    int nodes_until_check = 0;
+    int64_t nodes = 0;
+
+    // History heuristic: for each action, indexed by player, god, action type
+    // and field, how often it was part of a turn that caused a beta cut-off,
+    // weighted by the square of the remaining depth. Aged at the start of each
+    // search.
+    int history[2][GOD_COUNT][Action::SPECIAL + 1][FIELD_COUNT] = {};
+
+    // Shared between searchers.
+    TranspositionTable &tt;
+
+    // Used to shuffle the root turns (see FindBestTurns()).
+    rng_t rng;
+
+    // Must not be resized during search, since we hold references to elements.
+    std::vector<PlyBuffers> plies;
+
+    // Turns at the root, with their values from the last iteration, so that
+    // the next iteration can search the best turns first.
+    std::vector<ScoredTurn> root_turns;
+    std::vector<Turn> iteration_best_turns;
+};
+
+bool Searcher::Aborted() {
+    if (!aborted && (deadline || stop) && --nodes_until_check <= 0) {
+        nodes_until_check = deadline_check_interval;
+        aborted = (stop && stop->load(std::memory_order_relaxed)) || (deadline && clock::now() >= *deadline);
+    }
+    return aborted;
+}
+
+void Searcher::ReorderMoves(State &state, std::vector<Turn> &turns, int depth, int ply) {
     assert(depth > 0);
-    std::vector<std::pair<int, Turn>> tmp;
-    tmp.reserve(turns.size());
+    std::vector<ScoredTurn> &tmp = plies[ply].scored_turns;
+    tmp.clear();
     for (const Turn &turn : turns) {
         // TODO: this is doing duplicate work, maybe it makes sense to combine
         // this into Search() which also evaluates the new states for all turns?
-        State new_state = state;
-        ExecuteTurn(new_state, turn);
-        int value = -Search(new_state, depth - 1, -inf, inf, experiment);
-        tmp.push_back({value, turn});
+        StateUndo undo;
+        ExecuteTurn(state, turn, undo);
+        int value = -Search(state, depth - 1, ply + 1, -inf, inf);
+        UndoTurn(state, undo);
+        if (aborted) return;
+        tmp.push_back({.value = value, .index = 0, .turn = turn});
     }
-    std::sort(tmp.rbegin(), tmp.rend());
+    // Stable, so that turns with equal values stay shuffled (see FindBestTurns()).
+    SortByValue(tmp);
     for (size_t i = 0; i < turns.size(); ++i) {
-        turns[i] = tmp[i].second;
+        turns[i] = tmp[i].turn;
+    }
+}
+
+int Searcher::HistoryScore(Player player, const Turn &turn) const {
+    int score = 0;
+    for (int i = 0; i < turn.naction; ++i) {
+        const Action &action = turn.actions[i];
+        score += history[player][action.god][action.type][action.field];
+    }
+    return score;
+}
+
+void Searcher::OrderTurns(const State &state, std::vector<Turn> &turns, int ply, const std::optional<Turn> &hash_turn) {
+    const Player player = state.NextPlayer();
+    std::vector<ScoredTurn> &tmp = plies[ply].scored_turns;
+    tmp.clear();
+    bool any_history = false;
+    for (const Turn &turn : turns) {
+        int score = HistoryScore(player, turn);
+        any_history |= score != 0;
+        tmp.push_back({.value = score, .index = 0, .turn = turn});
+    }
+    if (any_history) {
+        SortByValue(tmp);
+        for (size_t i = 0; i < turns.size(); ++i) turns[i] = tmp[i].turn;
+    }
+    for (int i = killers_per_ply - 1; i >= 0; --i) {
+        const Turn &killer = plies[ply].killers[i];
+        if (killer.naction > 0) MoveToFront(turns, killer);
+    }
+    if (hash_turn) MoveToFront(turns, *hash_turn);
+}
+
+void Searcher::RecordCutoff(Player player, const Turn &turn, int depth_left, int ply) {
+    Turn *killers = plies[ply].killers;
+    if (killers[0] != turn) {
+        std::copy_backward(killers, killers + killers_per_ply - 1, killers + killers_per_ply);
+        killers[0] = turn;
+    }
+    for (int i = 0; i < turn.naction; ++i) {
+        const Action &action = turn.actions[i];
+        history[player][action.god][action.type][action.field] += depth_left * depth_left;
     }
 }
 
@@ -87,7 +357,24 @@ void ReorderMoves(const State &state, std::vector<Turn> &turns, int depth, bool
 //
 // Returns an exact value strictly between alpha and beta, or an upper bound
 // less than or equal to alpha, or a lower bound greater than or equal to beta.
-int Search(const State &state, int depth_left, int alpha, int beta, bool experiment) {
+//
+// Turns are executed on `state` and undone afterwards, so when this function
+// returns, the state is the same as when it was called.
+//
+// Results are stored in the transposition table, which is used both to return
+// early when the same state was searched before with sufficient depth, and to
+// search the best turn of a previous search first.
+//
+// If the search is aborted (see Aborted()), the return value is meaningless
+// and nothing is stored in the transposition table.
+int Searcher::Search(State &state, int depth_left, int ply, int alpha, int beta) {
+    if (depth_left == 0 && options.qsearch_depth > 0) {
+        return Quiesce(state, 0, ply, alpha, beta);
+    }
+
+    if (Aborted()) return 0;
+    ++nodes;
+
     if (state.IsOver()) {
         assert(state.Winner() == Other(state.NextPlayer()));
         // Next player loses. Value is discounted by how deep down the search
@@ -95,40 +382,219 @@ int Search(const State &state, int depth_left, int alpha, int beta, bool experim
         return -(win + depth_left - default_max_search_depth);
     }
 
+    // Endgame positions are solved exactly by the tablebase, at any depth.
+    if (options.tablebase) {
+        if (auto result = options.tablebase->Probe(state)) return TablebaseValue(*result, depth_left);
+    }
+
     if (depth_left == 0) {
-        return Evaluate(state, experiment);
+        return Evaluate(state, options.weights);
     }
 
-    std::vector<Turn> turns = GenerateTurns(state);
-    if (depth_left > 2) ReorderMoves(state, turns, depth_left - 2, experiment);
+    if (CanWinThisTurn(state)) {
+        // Same value as a search that finds the winning turn, but without
+        // generating turns.
+        return win + (depth_left - 1) - default_max_search_depth;
+    }
+
+    const uint64_t hash = state.Hash();
+    std::optional<Turn> hash_turn;
+    if (TranspositionEntry entry; tt.Probe(hash, entry)) {
+        if (entry.depth >= depth_left) {
+            int value = ScoreFromTable(entry.score, depth_left);
+            if (entry.bound == Bound::EXACT ||
+                    (entry.bound == Bound::LOWER && value >= beta) ||
+                    (entry.bound == Bound::UPPER && value <= alpha)) {
+                return value;
+            }
+        }
+        if (entry.best_turn.naction > 0) hash_turn = entry.best_turn;
+    }
 
+    // Null-move pruning: if passing the turn with a reduced search depth still
+    // fails high, assume that some real turn would too. This is not done twice
+    // in a row, nor near mate scores, and only if the static evaluation already
+    // suggests a cut-off. The assumption fails if passing is better than any
+    // turn (zugzwang), which is rare in this game.
+    if (options.null_move && depth_left >= null_move_min_depth && !plies[ply].null_move &&
+            abs(beta) < win/2 && Evaluate(state, options.weights) >= beta) {
+        state.EndTurn();
+        plies[ply + 1].null_move = true;
+        int value = -Search(state, depth_left - 1 - null_move_reduction, ply + 1, -beta, -beta + 1);
+        plies[ply + 1].null_move = false;
+        state.EndTurn();
+        if (aborted) return 0;
+        if (value >= beta) return value < win/2 ? value : beta;
+    }
+
+    const bool heuristic_ordering = options.ordering == MinimaxPlayerOpts::HEURISTIC;
+    const int original_alpha = alpha;
     int best_value = -inf;
-    for (const Turn &turn : turns) {
-        State new_state = state;
-        ExecuteTurn(new_state, turn);
-        int value = -Search(new_state, depth_left - 1, -beta, -alpha, experiment);
+    Turn best_turn = {};
+    int turn_index = 0;
+
+    // Searches `turn`, and returns true if there is a beta cut-off.
+    auto search_turn = [&](const Turn &turn) {
+        // Late-move reductions: quiet turns that are ordered late are
+        // unlikely to be best, so first search them with a reduced depth
+        // and a zero window, and search them fully only if that fails.
+        const bool reduce = options.lmr && depth_left >= lmr_min_depth &&
+            turn_index >= lmr_min_turn_index && best_value > -inf &&
+            !IsQuiescenceTurn(state, turn);
+        ++turn_index;
+        StateUndo undo;
+        ExecuteTurn(state, turn, undo);
+        int value = 0;
+        bool failed_low = false;
+        if (reduce) {
+            value = -Search(state, depth_left - 1 - lmr_reduction, ply + 1, -alpha - 1, -alpha);
+            failed_low = value <= alpha;
+        }
+        if (failed_low || aborted) {
+            // Skip the full search.
+        } else if (options.pvs && best_value > -inf) {
+            // Principal variation search: after the first turn, try to
+            // prove that the other turns are not better, using a zero
+            // window, and search again only if that fails.
+            value = -Search(state, depth_left - 1, ply + 1, -alpha - 1, -alpha);
+            if (value > alpha && value < beta && !aborted) {
+                value = -Search(state, depth_left - 1, ply + 1, -beta, -alpha);
+            }
+        } else {
+            value = -Search(state, depth_left - 1, ply + 1, -beta, -alpha);
+        }
+        UndoTurn(state, undo);
+        if (aborted) return false;
         if (value > best_value) {
             best_value = value;
-            if (value >= beta) break;  // beta cut-off
+            best_turn = turn;
             if (value > alpha) alpha = value;
         }
+        if (best_value < beta) return false;
+        if (heuristic_ordering) RecordCutoff(state.NextPlayer(), turn, depth_left, ply);
+        return true;
+    };
+
+    // Near the leaves, turns are generated in stages, so that after a beta
+    // cut-off, the remaining turns don't need to be generated at all. The hash
+    // turn is searched first, and skipped when its stage comes up. Since hash
+    // collisions are possible, it is only searched if it is legal, which
+    // requires generating the turns that start the same way.
+    //
+    // Higher in the tree, all turns are generated, so they can be reordered
+    // (either by a shallower search, or by heuristics, see OrderTurns()).
+    //
+    // Duplicate turns are only removed higher in the tree, since near the
+    // leaves, executing each turn to deduplicate it costs about as much as
+    // searching the duplicates.
+    std::vector<Turn> &turns = plies[ply].turns;
+    StagedTurnGenerator &generator = plies[ply].generator;
+    const bool staged = depth_left <= 2;
+    bool cutoff = false;
+    if (staged) {
+        // CanWinThisTurn() was checked above.
+        generator.Reset(state, false);
+        if (hash_turn && !generator.Contains(*hash_turn)) hash_turn.reset();
+        if (hash_turn) cutoff = search_turn(*hash_turn);
+        if (aborted) return 0;
+        if (!cutoff) generator.Next(turns);
+    } else {
+        GenerateUniqueTurns(state, turns, plies[ply].seen);
+        if (options.ordering == MinimaxPlayerOpts::SEARCH) ReorderMoves(state, turns, depth_left - 2, ply);
+    }
+    while (!cutoff) {
+        if (heuristic_ordering) {
+            OrderTurns(state, turns, ply, hash_turn);
+        } else if (hash_turn && !staged) {
+            MoveToFront(turns, *hash_turn);
+        }
+        for (const Turn &turn : turns) {
+            if (staged && hash_turn && turn == *hash_turn) continue;
+            cutoff = search_turn(turn);
+            if (aborted) return 0;
+            if (cutoff) break;
+        }
+        if (!staged || !generator.Next(turns)) break;
     }
+
+    Bound bound =
+        best_value <= original_alpha ? Bound::UPPER :
+        best_value >= beta ? Bound::LOWER : Bound::EXACT;
+    // When all turns failed low, the best turn is not meaningful.
+    tt.Store(hash, depth_left, bound, ScoreToTable(best_value, depth_left),
+            bound == Bound::UPPER ? nullptr : &best_turn);
     return best_value;
 }
 
-int FindBestTurns(const State &state, int search_depth, std::vector<Turn> &best_turns, bool experiment) {
-    assert(search_depth > 0 && !state.IsOver());
-    best_turns.clear();
+int Searcher::Quiesce(State &state, int depth_left, int ply, int alpha, int beta) {
+    if (Aborted()) return 0;
+    ++nodes;
 
-    std::vector<Turn> turns = GenerateTurns(state);
-    if (search_depth > 2) ReorderMoves(state, turns, search_depth - 2, experiment);
+    if (state.IsOver()) {
+        // Same as in Search(). Since depth_left is not positive here, wins
+        // found by the quiescence search are discounted further.
+        return -(win + depth_left - default_max_search_depth);
+    }
+
+    if (options.tablebase) {
+        if (auto result = options.tablebase->Probe(state)) return TablebaseValue(*result, depth_left);
+    }
+
+    int best_value = Evaluate(state, options.weights);
+    if (best_value >= beta || depth_left <= -options.qsearch_depth) return best_value;
+    if (best_value > alpha) alpha = best_value;
 
+    // Candidate turns are found in the first stages of the staged generator,
+    // so summons don't need to be generated.
+    std::vector<Turn> &turns = plies[ply].turns;
+    StagedTurnGenerator &generator = plies[ply].generator;
+    generator.Reset(state);
+    while (generator.Next(turns)) {
+        for (const Turn &turn : turns) {
+            if (!IsQuiescenceTurn(state, turn)) continue;
+            StateUndo undo;
+            ExecuteTurn(state, turn, undo);
+            int value = -Quiesce(state, depth_left - 1, ply + 1, -beta, -alpha);
+            UndoTurn(state, undo);
+            if (aborted) return 0;
+            if (value > best_value) {
+                best_value = value;
+                if (value > alpha) alpha = value;
+            }
+            if (best_value >= beta) return best_value;
+        }
+        if (generator.LastStage() >= StagedTurnGenerator::MOVES) break;
+    }
+    return best_value;
+}
+
+// Searches all root turns to the given depth, in the order of `root_turns`,
+// and updates their values. Turns with the best value are stored in
+// `best_turns` (only the first one with the shuffle_root option). Values of
+// other turns are only upper bounds.
+//
+// Like Search(), the result is exact only if it is strictly between alpha and
+// beta; otherwise `best_turns` is meaningless.
+int Searcher::SearchRoot(State &state, int depth, int alpha, int beta, std::vector<Turn> &best_turns) {
+    best_turns.clear();
     int best_value = -inf;
-    for (const Turn &turn : turns) {
-        State new_state = state;
-        ExecuteTurn(new_state, turn);
-        // +1 here allows collecting all the best moves, instead of just the first:
-        int value = -Search(new_state, search_depth - 1, -inf, -best_value + 1, experiment);
+    for (auto &[value, index, turn] : root_turns) {
+        // Only turns that are better than the best turn so far are relevant,
+        // or equally good, if we collect all best turns.
+        int lower = std::max(alpha, options.shuffle_root ? best_value : best_value - 1);
+        StateUndo undo;
+        ExecuteTurn(state, turn, undo);
+        if (options.pvs && best_value > -inf) {
+            value = -Search(state, depth - 1, 1, -lower - 1, -lower);
+            if (value > lower && value < beta && !aborted) {
+                value = -Search(state, depth - 1, 1, -beta, -lower);
+            }
+        } else {
+            value = -Search(state, depth - 1, 1, -beta, -lower);
+        }
+        UndoTurn(state, undo);
+        if (aborted) break;
+        if (value <= lower) continue;
         if (value == best_value) {
             best_turns.push_back(turn);
         } else if (value > best_value) {
@@ -136,52 +602,241 @@ int FindBestTurns(const State &state, int search_depth, std::vector<Turn> &best_
             best_turns.push_back(turn);
             best_value = value;
         }
+        if (best_value >= beta) break;
+    }
+    return best_value;
+}
+
+void Searcher::StartSearch(const State &state, int max_depth) {
+    assert(max_depth > 0 && !state.IsOver());
+    const size_t ply_count = max_depth + 1 + options.qsearch_depth;
+    if (plies.size() < ply_count) plies.resize(ply_count);
+    aborted = false;
+    nodes_until_check = 0;
+    nodes = 0;
+    for (PlyBuffers &buffers : plies) std::ranges::fill(buffers.killers, Turn{});
+    for (auto &a : history) for (auto &b : a) for (auto &c : b) for (int &score : c) score /= 2;
+    GenerateUniqueTurns(state, plies[0].turns, plies[0].seen);
+}
+
+int Searcher::FindBestTurns(
+        const State &initial_state, int max_depth, std::optional<clock::time_point> deadline,
+        std::vector<Turn> &best_turns, int &depth_reached) {
+    best_turns.clear();
+    depth_reached = 0;
+    State state = initial_state;
+    StartSearch(state, max_depth);
+    this->deadline = deadline;
+
+    std::vector<Turn> &turns = plies[0].turns;
+    if (options.shuffle_root) std::ranges::shuffle(turns, rng);
+
+    int best_value = -inf;
+    for (int depth = deadline ? 1 : max_depth; depth <= max_depth; ++depth) {
+        if (depth_reached == 0) {
+            // First iteration: order turns using a shallow search.
+            if (depth > 2 && options.ordering == MinimaxPlayerOpts::SEARCH) ReorderMoves(state, turns, depth - 2, 0);
+            root_turns.clear();
+            for (const Turn &turn : turns) root_turns.push_back({.value = 0, .index = 0, .turn = turn});
+        } else {
+            // Search the best turns of the previous iteration first.
+            SortByValue(root_turns);
+        }
+
+        // Never abort the first iteration, so we always have a result.
+        if (depth_reached == 0) this->deadline.reset();
+        int value;
+        if (int window = options.aspiration_window; window > 0 && depth_reached > 0 && abs(best_value) < win/2) {
+            int alpha = best_value - window, beta = best_value + window;
+            value = SearchRoot(state, depth, alpha, beta, iteration_best_turns);
+            if ((value <= alpha || value >= beta) && !aborted) {
+                value = SearchRoot(state, depth, -inf, inf, iteration_best_turns);
+            }
+        } else {
+            value = SearchRoot(state, depth, -inf, inf, iteration_best_turns);
+        }
+        this->deadline = deadline;
+        if (aborted) break;
+
+        best_value = value;
+        best_turns.swap(iteration_best_turns);
+        depth_reached = depth;
+
+        // Stop early if the outcome of the game is decided.
+        if (abs(value) > win/2) break;
     }
     return best_value;
 }
 
+void Searcher::Help(const State &initial_state, int max_depth, int helper_index) {
+    State state = initial_state;
+    StartSearch(state, max_depth);
+    deadline.reset();
+
+    const std::vector<Turn> &turns = plies[0].turns;
+    root_turns.clear();
+    for (size_t i = 0; i < turns.size(); ++i) {
+        root_turns.push_back({.value = 0, .index = 0, .turn = turns[(i + helper_index) % turns.size()]});
+    }
+    for (int depth = 1 + helper_index % 2; depth <= max_depth; ++depth) {
+        SearchRoot(state, depth, -inf, inf, iteration_best_turns);
+        if (aborted) break;
+        SortByValue(root_turns);
+    }
+}
+
+int MaxSearchDepth(const MinimaxPlayerOpts &opts) {
+    return
+        opts.max_depth > 0 ? opts.max_depth :
+        opts.max_time_ms > 0 ? max_iterative_search_depth :
+        default_max_search_depth;
+}
+
+// Returns nothing if the evaluation weights or tablebase cannot be read. An
+// error is printed in that case.
+std::optional<SearchOptions> MakeSearchOptions(const MinimaxPlayerOpts &opts) {
+    SearchOptions options = {
+        .weights  = opts.experiment ? experiment_eval_weights : default_eval_weights,
+        .ordering = opts.ordering,
+        .pvs = opts.pvs,
+        .aspiration_window = opts.aspiration_window,
+        .shuffle_root = opts.shuffle_root,
+        .qsearch_depth =
+            !opts.qsearch ? 0 :
+            opts.qsearch_depth > 0 ? opts.qsearch_depth :
+            default_qsearch_depth,
+        .null_move = opts.null_move,
+        .lmr = opts.lmr,
+        .tablebase = nullptr,
+    };
+    if (!opts.weights_file.empty()) {
+        if (auto loaded = LoadEvalWeights(opts.weights_file); !loaded) {
+            std::cerr << "Failed to load evaluation weights from " << opts.weights_file << '\n';
+            return {};
+        } else {
+            options.weights = *loaded;
+        }
+    }
+    if (!opts.tablebase_file.empty()) {
+        options.tablebase = Tablebase::Open(opts.tablebase_file);
+        if (!options.tablebase) {
+            std::cerr << "Failed to open tablebase " << opts.tablebase_file << '\n';
+            return {};
+        }
+    }
+    return options;
+}
+
 }  // namespace
 
 class MinimaxPlayer : public GamePlayer {
 public:
-    MinimaxPlayer(int max_search_depth, bool experiment, bool verbose) :
+    MinimaxPlayer(int max_search_depth, int max_time_ms, int tt_mb, int threads, const SearchOptions &options,
+            std::unique_ptr<OpeningBook> book, bool verbose) :
             rng(InitializeRng()),
             max_search_depth(max_search_depth),
-            experiment(experiment),
-            verbose(verbose) {}
+            max_time_ms(max_time_ms),
+            options(options),
+            book(std::move(book)),
+            verbose(verbose),
+            tt(tt_mb),
+            searcher(this->options, tt) {
+        for (int i = 1; i < threads; ++i) helpers.emplace_back(this->options, tt, &stop_helpers);
+    }
+
+    // Not copyable or movable, since searchers refer to members.
+    MinimaxPlayer(const MinimaxPlayer&) = delete;
+    MinimaxPlayer& operator=(const MinimaxPlayer&) = delete;
 
     std::optional<Turn> SelectTurn(const State &state) override;
 
 private:
     rng_t rng;
     int max_search_depth;
-    bool experiment;
+    int max_time_ms;  // 0 if unlimited
+    SearchOptions options;
+    std::unique_ptr<OpeningBook> book;  // null if disabled
     bool verbose;
+
+    // Persists between searches, since results are often reused after the
+    // opponent's turn.
+    TranspositionTable tt;
+
+    Searcher searcher;
+    std::vector<Searcher> helpers;
+    std::atomic<bool> stop_helpers;
+    std::vector<Turn> best_turns;
 };
 
 std::optional<Turn> MinimaxPlayer::SelectTurn(const State &state) {
-    std::vector<Turn> turns;
-    int value = FindBestTurns(state, max_search_depth, turns, experiment);
-    assert(!turns.empty());
-    int start_value = Evaluate(state, experiment);
+    if (book) {
+        if (std::optional<Turn> turn = book->Lookup(state)) {
+            if (verbose) std::cerr << "Book turn: " << *turn << '\n';
+            return turn;
+        }
+    }
+
+    std::optional<Searcher::clock::time_point> deadline;
+    if (max_time_ms > 0) deadline = Searcher::clock::now() + std::chrono::milliseconds(max_time_ms);
+    int depth_reached = 0;
+    tt.NewSearch();
+    stop_helpers = false;
+    std::vector<std::thread> helper_threads;
+    for (size_t i = 0; i < helpers.size(); ++i) {
+        helper_threads.emplace_back([this, &state, i]() {
+            helpers[i].Help(state, max_search_depth, i + 1);
+        });
+    }
+    int value = searcher.FindBestTurns(state, max_search_depth, deadline, best_turns, depth_reached);
+    stop_helpers = true;
+    for (std::thread &thread : helper_threads) thread.join();
+    assert(!best_turns.empty());
+    int start_value = Evaluate(state, options.weights);
     if (verbose) {
+        if (deadline) std::cerr << "Search depth: " << depth_reached << '\n';
+        std::cerr << "Nodes searched: " << searcher.Nodes() << '\n';
         std::cerr << "Minimax value: " << value << " (" << (value > start_value ? "+" : "") << (value - start_value) << ")\n";
         std::cerr << "Optimal turns:";
-        for (const Turn &turn : turns) std::cerr << ' ' << turn;
+        for (const Turn &turn : best_turns) std::cerr << ' ' << turn;
         std::cerr << '\n';
     }
     Turn turn;
-    if (turns.size() == 1) {
+    if (best_turns.size() == 1) {
         // Only one choice.
-        turn = turns[0];
+        turn = best_turns[0];
     } else {
-        turn = Choose(rng, turns);
+        turn = Choose(rng, best_turns);
         if (verbose) std::cerr << "Randomly selected: " << turn << '\n';
     }
     return turn;
 }
 
 GamePlayer *CreateMinimaxPlayer(const MinimaxPlayerOpts &opts) {
-    int max_depth = opts.max_depth > 0 ? opts.max_depth : default_max_search_depth;
-    return new MinimaxPlayer(max_depth, opts.experiment, opts.verbose);
+    std::optional<SearchOptions> options = MakeSearchOptions(opts);
+    if (!options) return nullptr;
+    int tt_mb = opts.tt_mb >= 0 ? opts.tt_mb : default_tt_mb;
+    int threads = opts.threads > 0 ? opts.threads : 1;
+    std::unique_ptr<OpeningBook> book;
+    if (!opts.book_file.empty()) {
+        book = OpeningBook::Open(opts.book_file);
+        if (!book) {
+            std::cerr << "Failed to open opening book " << opts.book_file << '\n';
+            return nullptr;
+        }
+    }
+    return new MinimaxPlayer(MaxSearchDepth(opts), opts.max_time_ms, tt_mb, threads, *options, std::move(book), opts.verbose);
+}
+
+std::optional<MinimaxSearchResult> SearchMinimax(const MinimaxPlayerOpts &opts, const State &state) {
+    std::optional<SearchOptions> options = MakeSearchOptions(opts);
+    if (!options) return {};
+    TranspositionTable tt(opts.tt_mb >= 0 ? opts.tt_mb : default_tt_mb);
+    tt.NewSearch();
+    Searcher searcher(*options, tt);
+    std::optional<Searcher::clock::time_point> deadline;
+    if (opts.max_time_ms > 0) deadline = Searcher::clock::now() + std::chrono::milliseconds(opts.max_time_ms);
+    MinimaxSearchResult result;
+    int depth_reached = 0;
+    result.value = searcher.FindBestTurns(state, MaxSearchDepth(opts), deadline, result.best_turns, depth_reached);
+    return result;
 }
@@ -5,6 +5,8 @@
 
 #include "moves.h"
 
+#include <algorithm>
+#include <cmath>
 #include <sstream>
 
 namespace {
@@ -15,16 +17,57 @@ constexpr int ares_special_rng       = 1;
 constexpr int artemis_horizontal_rng = 7;
 constexpr int artemis_special_dmg    = 1;
 
+// Selects a uniformly random turn from a sequence of turns of unknown length,
+// while storing only the selected turn. This is reservoir sampling with a
+// reservoir of size 1, using Li's "Algorithm L", which computes how many turns
+// to skip before the next replacement, so that only O(log n) random numbers are
+// needed for n turns.
+class ReservoirSampler {
+public:
+    explicit ReservoirSampler(rng_t &rng) : rng(rng) {}
+
+    void Add(const Turn &turn) {
+        if (++count < next) return;
+        selected = turn;
+        w *= Random();
+        next = count + 1 + std::floor(std::log(Random()) / std::log1p(-w));
+    }
+
+    // Number of turns added so far.
+    int64_t Count() const { return count; }
+
+    const Turn &Selected() const { assert(count > 0); return selected; }
+
+private:
+    // Returns a random number in the range (0, 1].
+    double Random() { return 1.0 - std::uniform_real_distribution<double>()(rng); }
+
+    rng_t &rng;
+    double w = 1.0;
+    int64_t count = 0;
+    double next = 1;  // index (1-based) of the next turn to select
+    Turn selected = {};
+};
+
 // Helper class to collect the list of valid turns. Each turn consists of a
 // sequence of actions, which is generated recursively. This class helps
 // maintain the intermediate sequence of actions and the corresponding state
 // after applying those actions to the initial state.
+//
+// If `unique_states` is not null, turns are only added if the resulting state
+// was not in the set before.
+//
+// Alternatively, turns can be passed to a sampler instead of being collected.
 class TurnBuilder {
 public:
-    TurnBuilder(std::vector<Turn> &turns, State initial_state) : turns(turns) {
+    TurnBuilder(std::vector<Turn> &turns, const State &initial_state, StateHashSet *unique_states = nullptr) :
+            turns(&turns), unique_states(unique_states), state(initial_state) {
+        turn.naction = 0;
+    }
+
+    TurnBuilder(ReservoirSampler &sampler, const State &initial_state) :
+            sampler(&sampler), state(initial_state) {
         turn.naction = 0;
-        states[0] = std::move(initial_state);
-        nstate = 1;
     }
 
     // Not copyable.
@@ -33,7 +76,7 @@ public:
 
     ~TurnBuilder() {
         assert(turn.naction == 0);
-        assert(nstate == 1);
+        assert(napplied == 0);
     }
 
     void PushAction(Action action) {
@@ -44,7 +87,7 @@ public:
     void PopAction() {
         assert(turn.naction > 0);
         --turn.naction;
-        if (nstate > turn.naction + 1) --nstate;
+        if (napplied > turn.naction) UnapplyAction();
     }
 
     void PopActions(size_t n) {
@@ -52,17 +95,16 @@ public:
     }
 
     void AddTurn() {
-        turns.push_back(turn);
+        if (sampler) return sampler->Add(turn);
+        if (unique_states && !unique_states->Insert(CurrentState().Hash())) return;
+        turns->push_back(turn);
     }
 
     const State &StateByIndex(int index) {
         assert(0 <= index && index <= turn.naction);
-        while (nstate <= index) {
-            states[nstate] = states[nstate - 1];
-            ExecuteAction(states[nstate], turn.actions[nstate - 1]);
-            ++nstate;
-        }
-        return states[index];
+        while (napplied > index) UnapplyAction();
+        while (napplied < index) ApplyAction();
+        return state;
     }
 
     const State &PreviousState() {
@@ -97,22 +139,39 @@ public:
     }
 
 private:
-    std::vector<Turn> &turns;
+    void ApplyAction() {
+        state.StartRecording(undo[napplied]);
+        ExecuteAction(state, turn.actions[napplied]);
+        state.StopRecording();
+        ++napplied;
+    }
+
+    void UnapplyAction() {
+        --napplied;
+        state.Undo(undo[napplied]);
+    }
+
+    std::vector<Turn> *turns = nullptr;
+    StateHashSet *unique_states = nullptr;
+    ReservoirSampler *sampler = nullptr;
 
     Turn turn;
 
-    // states[n] is the state obtained after `n` actions. These states are
-    // computed lazily, since we don't always need to generate the state to
+    // `state` is the initial state after applying the first `napplied` actions
+    // of the current turn, and undo[i] reverts the i-th action. Actions are
+    // applied lazily, since we don't always need to generate the state to
     // determine a turn is valid.
     //
-    // Invariant: nstates <= turn.naction + 1
+    // Invariant: napplied <= turn.naction
     //
-    // Important: the reference returned by CurrentState() MUST NOT be
-    // invalidated by mutating calls to PushAction(), PopAction() or AddTurn()
-    // (unless the active state itself is popped), which is why we use a fixed
-    // size array here, instead of e.g. std::vector<>.
-    std::array<State, Turn::MAX_ACTION + 1> states;
-    size_t nstate = 0;
+    // Important: since there is only a single state object, the reference
+    // returned by CurrentState() refers to a different state after more
+    // actions are pushed and applied. Callers should only use the state while
+    // no other actions are pushed, or after they have been popped again, which
+    // restores the state.
+    State state;
+    std::array<StateUndo, Turn::MAX_ACTION> undo;
+    int napplied = 0;
 };
 
 // A rectangular area to be attacked. Includes all fields with coords (r, c)
@@ -152,6 +211,10 @@ struct Area {
         return r1 <= r && r <= r2 && c1 <= c && c <= c2;
     }
 
+    field_mask_t Mask() const {
+        return RectMask(r1, c1, r2, c2);
+    }
+
     static Area Get(Player player, God god, field_t field) {
         auto [r, c] = FieldCoords(field);
         switch (god) {
@@ -196,7 +259,8 @@ void GenerateMovesOne(TurnBuilder &builder, field_t field, bool may_summon_after
 
     const int speed_boost = state.has_fx(player, god, SPEED_BOOST) ? hermes_speed_boost : 0;
     const int max_dist = pantheon[god].mov + speed_boost;
-    std::span<const Dir> dirs = GetDirs(pantheon[god].mov_dirs);
+    const Dirs dirs = pantheon[god].mov_dirs;
+    const field_mask_t empty = ALL_FIELDS & ~state.Occupied();
 
     auto add_move_action = [&](field_t field) {
         auto scoped_action = builder.MakeScoped(Action{
@@ -218,66 +282,46 @@ void GenerateMovesOne(TurnBuilder &builder, field_t field, bool may_summon_after
     // The logic below is similar to GenerateAttacksOne(), defined below.
     // Try to keep the two in sync.
 
-    if (pantheon[god].mov_dirs & Dirs::DIRECT) {
+    if (dirs & Dirs::DIRECT) {
         // Direct moves only: scan each direction until we reach the end of the
         // board or an occupied field.
-        Coords coords = FieldCoords(field);
-        for (auto [dr, dc] : dirs) {
-            auto [r, c] = coords;
-            for (int dist = 1; dist <= max_dist; ++dist) {
-                r += dr;
-                c += dc;
-                field_t i = FieldIndex(r, c);
-                if (i == -1 || state.IsOccupied(i)) break;
-                add_move_action(i);
-            }
+        auto [dir_begin, dir_end] = DirRange(dirs);
+        for (int dir = dir_begin; dir < dir_end; ++dir) {
+            field_mask_t reachable = RayMaskUntil(dir, field, max_dist, ~empty) & empty;
+            while (reachable) add_move_action(PopField(reachable));
         }
     } else {
         // Indirect moves: breadth first search from the start.
         //
         // (Currently we don't allow a hero to land on the same field they
-        // started from, which is implemented by initializing seen[field] to
-        // true. The distinction only matters for Ares, but since he only moves
-        // in one direction, the distinction doesn't matter.)
-        Coords todo[FIELD_COUNT];
-        bool seen[FIELD_COUNT] = {};
-        seen[field] = true;
-        todo[0] = FieldCoords(field);
-        int pos = 0, end = 1;
-        for (int dist = 1; dist <= max_dist; ++dist) {
-            int cur_end = end;
-            while (pos < cur_end) {
-                auto [r, c] = todo[pos++];
-                for (auto [dr, dc] : dirs) {
-                    int8_t rr = r + dr;
-                    int8_t cc = c + dc;
-                    field_t i = FieldIndex(rr, cc);
-                    if (i == -1 || state.IsOccupied(i) || seen[i]) continue;
-                    add_move_action(i);
-                    seen[i] = true;
-                    todo[end++] = Coords{rr, cc};
-                }
-            }
+        // started from, which is implemented by initializing `seen` to contain
+        // the start field. The distinction only matters for Ares, but since he
+        // only moves in one direction, the distinction doesn't matter.)
+        field_mask_t seen = FieldMask(field);
+        field_mask_t todo = seen;
+        for (int dist = 1; dist <= max_dist && todo; ++dist) {
+            field_mask_t next = 0;
+            while (todo) next |= StepMask(dirs, PopField(todo));
+            todo = next & empty & ~seen;
+            seen |= todo;
+        }
+        for (field_mask_t mask = seen & ~FieldMask(field); mask; ) {
+            add_move_action(PopField(mask));
         }
 
         // Special case: Dionysus can jump on enemies to eliminate them.
         // This covers all cases where there is at least 1 elimination.
         if (god == DIONYSUS) {
             assert(max_dist == 1 || max_dist == 2);
-            auto accessible = [&](field_t field) {
-                if (field == -1) return false;
-                if (!state.IsOccupied(field)) return true;
-                int p = state.PlayerAt(field);
-                if (p == player) return false;  // cannot jump on ally
-                if (state.has_fx(AsPlayer(p), AsGod(state.GodAt(field)), SHIELDED)) return false;
-                return true;
-            };
-            auto [r0, c0] = FieldCoords(field);
-            for (auto [dr, dc] : dirs) {
-                int8_t r1 = r0 + dr;
-                int8_t c1 = c0 + dc;
-                field_t field1 = FieldIndex(r1, c1);
-                if (!accessible(field1)) continue;
+            field_mask_t vulnerable = 0;
+            for (field_mask_t mask = state.Occupied(Other(player)); mask; ) {
+                field_t f = PopField(mask);
+                if (!state.has_fx(Other(player), state.GodAt(f), SHIELDED)) vulnerable |= FieldMask(f);
+            }
+            // Fields that can be jumped on: empty fields and unshielded enemies.
+            const field_mask_t accessible = empty | vulnerable;
+            for (field_mask_t mask1 = StepMask(dirs, field) & accessible; mask1; ) {
+                field_t field1 = PopField(mask1);
                 bool special1 = state.IsOccupied(field1);
                 if (special1) {
                     builder.PushAction(Action{
@@ -288,17 +332,14 @@ void GenerateMovesOne(TurnBuilder &builder, field_t field, bool may_summon_after
                     builder.AddTurn();
                 }
                 if (max_dist == 2) {
-                    for (auto [dr, dc] : dirs) {
-                        int8_t r2 = r1 + dr;
-                        int8_t c2 = c1 + dc;
-                        field_t field2 = FieldIndex(r2, c2);
-                        if (!accessible(field2)) continue;
+                    for (field_mask_t mask2 = StepMask(dirs, field1) & accessible; mask2; ) {
+                        field_t field2 = PopField(mask2);
 
                         if (!special1) {
                             // Deduplicate only if we didn't hit anything on the
                             // first move, because turns will be equivalent:
-                            if (seen[field2]) continue;
-                            seen[field2] = true;
+                            if (seen & FieldMask(field2)) continue;
+                            seen |= FieldMask(field2);
                         }
 
                         bool special2 = state.IsOccupied(field2);
@@ -318,16 +359,10 @@ void GenerateMovesOne(TurnBuilder &builder, field_t field, bool may_summon_after
         // Artemis can move up to 7 sideways (or 8 when boosted by Hermes)
         if (god == ARTEMIS) {
             int horiz_dist = artemis_horizontal_rng + speed_boost;
-            auto [r, c] = FieldCoords(field);
-            for (int i = 1; i <= horiz_dist; ++i) {
-                field_t field = FieldIndex(r, c + i);
-                if (field == -1 || state.IsOccupied(field)) break;
-                if (i > max_dist) add_move_action(field);
-            }
-            for (int i = 1; i <= horiz_dist; ++i) {
-                field_t field = FieldIndex(r, c - i);
-                if (field == -1 || state.IsOccupied(field)) break;
-                if (i > max_dist) add_move_action(field);
+            for (int dir : {DIR_RIGHT, DIR_LEFT}) {
+                field_mask_t reachable = RayMaskUntil(dir, field, horiz_dist, ~empty) & empty;
+                reachable &= ~DistanceMask(field, max_dist);
+                while (reachable) add_move_action(PopField(reachable));
             }
         }
     }
@@ -337,11 +372,111 @@ void GenerateMovesAll(TurnBuilder &builder, bool may_summon_after) {
     const State &state = builder.CurrentState();
     const Player player = state.NextPlayer();
     const field_t gate = gate_index[player];
-    for (field_t field = 0; field < FIELD_COUNT; ++field) {
-        if (state.PlayerAt(field) == player) {
-            GenerateMovesOne(builder, field, field == gate && may_summon_after);
+    for (field_mask_t mask = state.Occupied(player); mask; ) {
+        field_t field = PopField(mask);
+        GenerateMovesOne(builder, field, field == gate && may_summon_after);
+    }
+}
+
+// Returns false if `god` cannot move from `src` to `dst` in a single move,
+// with the given speed boost, even without obstacles. Used to avoid more
+// expensive checks.
+bool MayReach(God god, int speed_boost, field_t src, field_t dst) {
+    int dist = pantheon[god].mov + speed_boost;
+    if (god == DIONYSUS) dist *= 2;  // knight jumps
+    if (DistanceMask(dst, dist) & FieldMask(src)) return true;
+    return god == ARTEMIS && FieldCoords(src).r == FieldCoords(dst).r;
+}
+
+// Returns true if `player`'s `god` can move onto `dst` with a single move.
+// This follows the same rules as GenerateMovesOne(), but only checks whether
+// `dst` is reachable. Try to keep the two in sync.
+bool CanMoveOnto(const State &state, Player player, God god, field_t dst) {
+    const field_t field = state.fi(player, god);
+    assert(field != -1);
+
+    if (state.has_fx(player, god, CHAINED)) return false;
+
+    const int speed_boost = state.has_fx(player, god, SPEED_BOOST) ? hermes_speed_boost : 0;
+    if (!MayReach(god, speed_boost, field, dst)) return false;
+
+    const int max_dist = pantheon[god].mov + speed_boost;
+    const Dirs dirs = pantheon[god].mov_dirs;
+    const field_mask_t empty = ALL_FIELDS & ~state.Occupied();
+    const field_mask_t target = FieldMask(dst);
+
+    if (dirs & Dirs::DIRECT) {
+        auto [dir_begin, dir_end] = DirRange(dirs);
+        for (int dir = dir_begin; dir < dir_end; ++dir) {
+            if (RayMaskUntil(dir, field, max_dist, ~empty) & empty & target) return true;
         }
+        return false;
     }
+
+    // Dionysus can also jump on unshielded enemies, eliminating them.
+    field_mask_t accessible = empty;
+    if (god == DIONYSUS) {
+        const Player opponent = Other(player);
+        for (field_mask_t mask = state.Occupied(opponent); mask; ) {
+            field_t f = PopField(mask);
+            if (!state.has_fx(opponent, state.GodAt(f), SHIELDED)) accessible |= FieldMask(f);
+        }
+    }
+    field_mask_t seen = FieldMask(field);
+    field_mask_t todo = seen;
+    for (int dist = 1; dist <= max_dist && todo; ++dist) {
+        field_mask_t next = 0;
+        while (todo) next |= StepMask(dirs, PopField(todo));
+        todo = next & accessible & ~seen;
+        if (todo & target) return true;
+        seen |= todo;
+    }
+
+    if (god == ARTEMIS) {
+        int horiz_dist = artemis_horizontal_rng + speed_boost;
+        for (int dir : {DIR_RIGHT, DIR_LEFT}) {
+            if (RayMaskUntil(dir, field, horiz_dist, ~empty) & empty & target) return true;
+        }
+    }
+    return false;
+}
+
+// Returns false if `player` cannot kill the enemy at `target` this turn, by
+// comparing its hit points with upper bounds on the damage and range of the
+// attacks of `player`'s gods (including gods that could be summoned). Used to
+// avoid generating turns in CanWinThisTurn().
+bool MayKill(const State &state, Player player, field_t target) {
+    const Player opponent = Other(player);
+    const int hp = state.hp(opponent, AsGod(state.GodAt(target)));
+
+    // Ares damages enemies next to where he lands, which is not worth checking
+    // in detail.
+    if (hp <= ares_special_dmg) return true;
+
+    auto may_attack = [&](God god, field_t src) {
+        // Artemis' special ability reaches any enemy (with Hephaestus' boost).
+        if (god == ARTEMIS && hp <= artemis_special_dmg + 1) return true;
+        // Hera may double damage, Apollo adds 1 on direct attacks, and
+        // Hephaestus adds 1 to any attack.
+        int max_damage = pantheon[god].dmg * (god == HERA ? 2 : 1) + (god == APOLLO ? 1 : 0) + 1;
+        if (max_damage < hp) return false;
+        // Area attacks; see Area::Get().
+        if (god == DIONYSUS) return std::abs(FieldCoords(src).r - FieldCoords(target).r) <= 1;
+        int range = god == POSEIDON ? 2 : pantheon[god].rng;
+        return (DistanceMask(target, range) & FieldMask(src)) != 0;
+    };
+    for (int g = 0; g < GOD_COUNT; ++g) {
+        const God god = AsGod(g);
+        if (state.IsInPlay(player, god) && may_attack(god, state.fi(player, god))) return true;
+    }
+    // Gods can be summoned if the gate is empty, or after a god moves off it.
+    const field_t own_gate = gate_index[player];
+    if (state.PlayerAt(own_gate) != opponent) {
+        for (int g = 0; g < GOD_COUNT; ++g) {
+            if (state.IsSummonable(player, AsGod(g)) && may_attack(AsGod(g), own_gate)) return true;
+        }
+    }
+    return false;
 }
 
 // Determines damage at an area killed an enemy at the opponent's gate,
@@ -370,8 +505,9 @@ void GenerateAttacksOne(TurnBuilder &builder, field_t field) {
     // Cannot attack when chained by Hades.
     if (state.has_fx(player, god, CHAINED)) return;
 
-    int max_dist = pantheon[god].rng;
-    std::span<const Dir> dirs = GetDirs(pantheon[god].atk_dirs);
+    const int max_dist = pantheon[god].rng;
+    const Dirs dirs = pantheon[god].atk_dirs;
+    const field_mask_t enemies = state.Occupied(opponent);
 
     struct Attack {
         field_t field;
@@ -411,29 +547,23 @@ void GenerateAttacksOne(TurnBuilder &builder, field_t field) {
         builder.PopActions(attacks.size());
     };
 
-    if (dirs.empty()) {
+    if ((dirs & 7) == Dirs::NONE) {
         // Area attacks. Handle specially.
         //
         // To limit the number of moves somewhat, only include attacks if the
         // area contains at least one enemy, even though it still might have no
         // effect when enemies are shielded by Athena.
         Area area = Area::Get(player, god, field);
-        for (int r = area.r1; r <= area.r2; ++r) {
-            for (int c = area.c1; c <= area.c2; ++c) {
-                if (int i = FieldIndex(r, c); i != -1 && state.PlayerAt(i) == opponent) {
-                    Attack attacks[1] = {Attack::AtArea(field, area)};
-                    add_attack_actions(attacks);
-                    goto done;
-                }
-            }
+        if (area.Mask() & enemies) {
+            Attack attacks[1] = {Attack::AtArea(field, area)};
+            add_attack_actions(attacks);
         }
-    done:
         return;
     }
 
     // The logic below is similar to GenerateMovesOne(), defined above.
     // Try to keep the two in sync.
-    if (pantheon[god].atk_dirs & Dirs::DIRECT) {
+    if (dirs & Dirs::DIRECT) {
         // Direct attacks only: scan each direction until we reach the end of
         // the board or an occupied field. (Note that we need more than the
         // obvious 8 fields [one per direction] here, because Zeus' attacks can
@@ -442,27 +572,17 @@ void GenerateAttacksOne(TurnBuilder &builder, field_t field) {
         field_t field_data[16];
         size_t field_size = 0;
         static_assert(GOD_COUNT <= std::size(field_data));
-        assert(std::size(field_data) >= std::size(dirs));
-
-        Coords coords = FieldCoords(field);
-        for (auto [dr, dc] : dirs) {
-            auto [r, c] = coords;
-            for (int dist = 1; dist <= max_dist; ++dist) {
-                r += dr;
-                c += dc;
-                field_t i = FieldIndex(r, c);
-                if (i == -1) break;
-                int pl = state.PlayerAt(i);
-                if (pl == opponent) {
-                    assert(field_size < std::size(field_data));
-                    field_data[field_size++] = i;
-                }
-                if (god == ZEUS) {
-                    // Zeus' special attack can pass over enemies and allies
-                } else {
-                    if (pl != -1) break;
-                }
-            }
+
+        // Zeus' special attack can pass over enemies and allies.
+        const field_mask_t blockers = god == ZEUS ? 0 : state.Occupied();
+        field_mask_t targets = 0;
+        auto [dir_begin, dir_end] = DirRange(dirs);
+        for (int dir = dir_begin; dir < dir_end; ++dir) {
+            targets |= RayMaskUntil(dir, field, max_dist, blockers) & enemies;
+        }
+        while (targets) {
+            assert(field_size < std::size(field_data));
+            field_data[field_size++] = PopField(targets);
         }
 
         // Execute any single attack:
@@ -504,50 +624,41 @@ void GenerateAttacksOne(TurnBuilder &builder, field_t field) {
             }
         }
     } else {
-        // Indirect attacks: breadth first search from the start.
-        Coords todo[FIELD_COUNT];
-        bool seen[FIELD_COUNT] = {};
-        seen[field] = true;
-        todo[0] = FieldCoords(field);
-        int pos = 0, end = 1;
-        for (int dist = 1; dist <= max_dist; ++dist) {
-            int cur_end = end;
-            while (pos < cur_end) {
-                auto [r, c] = todo[pos++];
-                for (auto [dr, dc] : dirs) {
-                    int8_t rr = r + dr;
-                    int8_t cc = c + dc;
-                    field_t i = FieldIndex(rr, cc);
-                    if (i == -1 || seen[i]) continue;
-                    seen[i] = true;
-                    int pl = state.PlayerAt(i);
-                    if (pl == -1) {
-                        todo[end++] = Coords{rr, cc};
-                    } else if (pl == opponent) {
-                        Attack attacks[1] = {Attack::AtField(i)};
-                        add_attack_actions(attacks);
-                    }
-                }
-            }
+        // Indirect attacks: breadth first search from the start, through
+        // empty fields only.
+        const field_mask_t empty = ALL_FIELDS & ~state.Occupied();
+        field_mask_t seen = FieldMask(field);
+        field_mask_t todo = seen;
+        field_mask_t targets = 0;
+        for (int dist = 1; dist <= max_dist && todo; ++dist) {
+            field_mask_t next = 0;
+            while (todo) next |= StepMask(dirs, PopField(todo));
+            next &= ~seen;
+            seen |= next;
+            targets |= next & enemies;
+            todo = next & empty;
+        }
+        while (targets) {
+            Attack attacks[1] = {Attack::AtField(PopField(targets))};
+            add_attack_actions(attacks);
         }
     }
 
     // Artemis can use her Withering Moon special ability instead of attacking.
     if (god == ARTEMIS) {
-        for (field_t field = 0; field < FIELD_COUNT; ++field) {
-            if (state.PlayerAt(field) == opponent) {
-                God god = AsGod(state.GodAt(field));
-                if (!state.has_fx(opponent, god, SHIELDED)) {
-                    TurnBuilder::Scoped action = builder.MakeScoped(Action{
-                        .type = Action::SPECIAL,
-                        .god = ARTEMIS,
-                        .field = field,
-                    });
-                    if (KilledEnemyAtGate(builder, Area::around(field, 0), opponent)) {
-                        // Special rule 3: when you kill an enemy on the opponent's
-                        // gate, you get an extra move.
-                        GenerateMovesAll(builder, false);
-                    }
+        for (field_mask_t mask = enemies; mask; ) {
+            field_t field = PopField(mask);
+            God god = AsGod(state.GodAt(field));
+            if (!state.has_fx(opponent, god, SHIELDED)) {
+                TurnBuilder::Scoped action = builder.MakeScoped(Action{
+                    .type = Action::SPECIAL,
+                    .god = ARTEMIS,
+                    .field = field,
+                });
+                if (KilledEnemyAtGate(builder, Area::around(field, 0), opponent)) {
+                    // Special rule 3: when you kill an enemy on the opponent's
+                    // gate, you get an extra move.
+                    GenerateMovesAll(builder, false);
                 }
             }
         }
@@ -557,10 +668,8 @@ void GenerateAttacksOne(TurnBuilder &builder, field_t field) {
 void GenerateAttacksAll(TurnBuilder &builder) {
     const State &state = builder.CurrentState();
     const Player player = state.NextPlayer();
-    for (field_t field = 0; field < FIELD_COUNT; ++field) {
-        if (state.PlayerAt(field) == player) {
-            GenerateAttacksOne(builder, field);
-        }
+    for (field_mask_t mask = state.Occupied(player); mask; ) {
+        GenerateAttacksOne(builder, PopField(mask));
     }
 }
 
@@ -587,19 +696,19 @@ void GenerateSpecialsAphrodite(TurnBuilder &builder) {
     if (src == -1) return;  // Aphrodite not on the board
 
     // Find ally to swap with:
-    for (field_t dst = 0; dst < FIELD_COUNT; ++dst) {
-        if (state.PlayerAt(dst) == player && src != dst) {
-            auto scoped_action = builder.MakeScoped(Action{
-                .type  = Action::SPECIAL,
-                .god   = APHRODITE,
-                .field = dst,
-            });
-            if (state.GodAt(dst) == ARES) {
-                GenerateSpecialsAres(builder, player, src);
-            }
-            if (state.GodAt(dst) == HADES) {
-                GenerateSpecialsHades(builder, false, false, false);
-            }
+    for (field_mask_t mask = state.Occupied(player) & ~FieldMask(src); mask; ) {
+        field_t dst = PopField(mask);
+        const God ally = state.GodAt(dst);
+        auto scoped_action = builder.MakeScoped(Action{
+            .type  = Action::SPECIAL,
+            .god   = APHRODITE,
+            .field = dst,
+        });
+        if (ally == ARES) {
+            GenerateSpecialsAres(builder, player, src);
+        }
+        if (ally == HADES) {
+            GenerateSpecialsHades(builder, false, false, false);
         }
     }
 }
@@ -622,10 +731,10 @@ void GenerateSpecialsHades(
     assert(src != -1);
 
     // Find enemy to chain:
-    for (field_t dst : Neighbors(src)) {
+    for (field_mask_t mask = StepMask(ALL8, src) & state.Occupied(opponent); mask; ) {
+        field_t dst = PopField(mask);
         God enemy = state.GodAt(dst);
-        if (enemy != GOD_COUNT && state.PlayerAt(dst) == opponent &&
-                !state.has_fx(opponent, enemy, CHAINED)) {
+        if (!state.has_fx(opponent, enemy, CHAINED)) {
             auto scoped_action = builder.MakeScoped(Action{
                 .type  = Action::SPECIAL,
                 .god   = HADES,
@@ -759,13 +868,10 @@ void DamageArea(State &state, Area area, Player opponent, int damage, int knock_
     }
 
     // Second pass: damage everyone in range except enemy Athena.
-    for (int r = area.r1; r <= area.r2; ++r) {
-        for (int c = area.c1; c <= area.c2; ++c) {
-            if (field_t field = FieldIndex(r, c); field != -1 &&
-                    field != athena_field && state.PlayerAt(field) == opponent) {
-                DamageField(state, field, opponent, damage);
-            }
-        }
+    field_mask_t targets = area.Mask() & state.Occupied(opponent);
+    if (athena_field != -1) targets &= ~FieldMask(athena_field);
+    while (targets) {
+        DamageField(state, PopField(targets), opponent, damage);
     }
 
     if (knock_dir != 0) {
@@ -848,6 +954,12 @@ void AphroditeSwap(State &state, field_t src, field_t dst) {
 
 std::vector<Turn> GenerateTurns(const State &state) {
     std::vector<Turn> turns;
+    GenerateTurns(state, turns);
+    return turns;
+}
+
+void GenerateTurns(const State &state, std::vector<Turn> &turns) {
+    turns.clear();
     TurnBuilder builder(turns, state);
     GenerateSummons(builder, true);
     GenerateMovesAll(builder, true);
@@ -857,7 +969,250 @@ std::vector<Turn> GenerateTurns(const State &state) {
         // Is passing always allowed?
         turns.push_back(Turn{.naction=0, .actions={}});
     }
-    return turns;
+}
+
+void GenerateUniqueTurns(const State &state, std::vector<Turn> &turns, StateHashSet &seen) {
+    turns.clear();
+    seen.Clear();
+    TurnBuilder builder(turns, state, &seen);
+    GenerateSummons(builder, true);
+    GenerateMovesAll(builder, true);
+    GenerateAttacksAll(builder);
+    GenerateSpecialsAphrodite(builder);
+    if (turns.empty()) {
+        // Is passing always allowed?
+        turns.push_back(Turn{.naction=0, .actions={}});
+    }
+}
+
+Turn SampleTurn(const State &state, rng_t &rng) {
+    ReservoirSampler sampler(rng);
+    {
+        TurnBuilder builder(sampler, state);
+        GenerateSummons(builder, true);
+        GenerateMovesAll(builder, true);
+        GenerateAttacksAll(builder);
+        GenerateSpecialsAphrodite(builder);
+    }
+    if (sampler.Count() == 0) {
+        // Is passing always allowed?
+        return Turn{.naction=0, .actions={}};
+    }
+    return sampler.Selected();
+}
+
+void StateHashSet::Clear() {
+    if (size > 0) std::fill(table.begin(), table.end(), 0);
+    size = 0;
+}
+
+bool StateHashSet::Insert(uint64_t hash) {
+    if (hash == 0) hash = 1;
+    if (2*(size + 1) > table.size()) Grow();
+    const size_t mask = table.size() - 1;
+    for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+        if (table[i] == hash) return false;
+        if (table[i] == 0) {
+            table[i] = hash;
+            ++size;
+            return true;
+        }
+    }
+}
+
+void StateHashSet::Grow() {
+    std::vector<uint64_t> old_table(table.size() < 256 ? 256 : 2*table.size());
+    old_table.swap(table);
+    size = 0;
+    for (uint64_t hash : old_table) if (hash != 0) Insert(hash);
+}
+
+field_mask_t AttackedEnemies(const State &state, const Action &action) {
+    const Player player = state.NextPlayer();
+    const field_mask_t enemies = state.Occupied(Other(player));
+    if (action.type == Action::ATTACK && pantheon[action.god].atk_dirs == Dirs::NONE) {
+        return Area::Get(player, action.god, action.field).Mask() & enemies;
+    }
+    if (action.type == Action::ATTACK || (action.type == Action::SPECIAL && action.god == ARTEMIS)) {
+        return FieldMask(action.field) & enemies;
+    }
+    return 0;
+}
+
+StagedTurnGenerator::Stage ClassifyTurn(const State &state, const Turn &turn) {
+    const Player player = state.NextPlayer();
+    const Player opponent = Other(player);
+    const field_t opponent_gate = gate_index[opponent];
+    for (int i = 0; i < turn.naction; ++i) {
+        const Action &action = turn.actions[i];
+        if ((action.type == Action::MOVE || (action.type == Action::SPECIAL && action.god == DIONYSUS)) &&
+                action.field == opponent_gate) {
+            return StagedTurnGenerator::WINS;
+        }
+    }
+    bool attack = false;
+    for (int i = 0; i < turn.naction; ++i) {
+        const Action &action = turn.actions[i];
+        if (action.type == Action::ATTACK ||
+                (action.type == Action::SPECIAL && action.god == ARTEMIS)) {
+            attack = true;
+            for (field_mask_t targets = AttackedEnemies(state, action); targets; ) {
+                const field_t target = PopField(targets);
+                int damage =
+                    action.type == Action::SPECIAL ? artemis_special_dmg :
+                    state.fi(player, action.god) != -1 ? GetDamage(state, player, action.god, target) :
+                    pantheon[action.god].dmg;
+                if (damage >= state.hp(opponent, AsGod(state.GodAt(target)))) {
+                    return StagedTurnGenerator::KILLS;
+                }
+            }
+        }
+    }
+    return attack ? StagedTurnGenerator::ATTACKS : StagedTurnGenerator::MOVES;
+}
+
+god_mask_t GateThreats(const State &state, Player player) {
+    const field_t gate = gate_index[Other(player)];
+    god_mask_t threats = 0;
+    for (int g = 0; g < GOD_COUNT; ++g) {
+        const God god = AsGod(g);
+        if (state.IsInPlay(player, god) && CanMoveOnto(state, player, god, gate)) threats |= GodMask(god);
+    }
+    return threats;
+}
+
+bool CanWinThisTurn(const State &state) {
+    assert(!state.IsOver());
+    const Player player = state.NextPlayer();
+    const Player opponent = Other(player);
+    const field_t own_gate = gate_index[player];
+    const field_t gate = gate_index[opponent];
+
+    if (GateThreats(state, player)) return true;
+
+    // Summon a god and move it in the same turn. (On the standard board, the
+    // gates are too far apart for this to matter.)
+    const bool may_summon = !state.IsOccupied(own_gate);
+    if (may_summon) {
+        for (int g = 0; g < GOD_COUNT; ++g) {
+            const God god = AsGod(g);
+            if (!state.IsSummonable(player, god)) continue;
+            if (!MayReach(god, hermes_speed_boost, own_gate, gate)) continue;
+            State summoned = state;
+            ExecuteAction(summoned, Action{.type = Action::SUMMON, .god = god, .field = own_gate});
+            if (CanMoveOnto(summoned, player, god, gate)) return true;
+        }
+    }
+
+    // Kill the enemy on the gate, and move onto it with the extra move.
+    // There are many ways to kill, so in this case, generate all turns if
+    // the enemy could possibly be killed and any god could reach the gate.
+    if (state.PlayerAt(gate) != opponent || !MayKill(state, player, gate)) return false;
+    bool may_reach = false;
+    for (int g = 0; g < GOD_COUNT && !may_reach; ++g) {
+        const God god = AsGod(g);
+        may_reach = state.IsInPlay(player, god) && MayReach(god, hermes_speed_boost, state.fi(player, god), gate);
+    }
+    const bool may_summon_later = state.PlayerAt(own_gate) != opponent;  // see MayKill()
+    for (int g = 0; g < GOD_COUNT && may_summon_later && !may_reach; ++g) {
+        may_reach = state.IsSummonable(player, AsGod(g)) && MayReach(AsGod(g), hermes_speed_boost, own_gate, gate);
+    }
+    if (!may_reach) return false;
+    std::vector<Turn> turns;
+    GenerateTurns(state, turns);
+    return std::ranges::any_of(turns, [&state](const Turn &turn) {
+        return ClassifyTurn(state, turn) == StagedTurnGenerator::WINS;
+    });
+}
+
+void StagedTurnGenerator::Reset(const State &state, bool may_win) {
+    this->state = &state;
+    this->may_win = may_win;
+    stage = WINS;
+    any_turns = false;
+    std::ranges::fill(generated_groups, false);
+    for (auto &turns : by_stage) turns.clear();
+}
+
+void StagedTurnGenerator::GenerateGroup(Group group) {
+    if (generated_groups[group]) return;
+    generated_groups[group] = true;
+    generated.clear();
+    {
+        TurnBuilder builder(generated, *state);
+        switch (group) {
+            case ATTACK_GROUP:
+                GenerateAttacksAll(builder);
+                break;
+            case MOVE_GROUP:
+                GenerateMovesAll(builder, true);
+                GenerateSpecialsAphrodite(builder);
+                break;
+            case SUMMON_GROUP:
+                GenerateSummons(builder, true);
+                break;
+            default:
+                assert(false);
+        }
+    }
+    for (const Turn &turn : generated) {
+        by_stage[ClassifyTurn(*state, turn)].push_back(turn);
+    }
+}
+
+bool StagedTurnGenerator::Contains(const Turn &turn) {
+    assert(stage == WINS);
+    if (turn.naction == 0) return false;
+    const Action &first = turn.actions[0];
+    const Group group =
+        first.type == Action::SUMMON ? SUMMON_GROUP :
+        first.type == Action::ATTACK || (first.type == Action::SPECIAL && first.god == ARTEMIS) ? ATTACK_GROUP :
+        MOVE_GROUP;
+    GenerateGroup(group);
+    return std::ranges::any_of(by_stage, [&turn](const std::vector<Turn> &turns) {
+        return std::ranges::find(turns, turn) != turns.end();
+    });
+}
+
+bool StagedTurnGenerator::Next(std::vector<Turn> &turns) {
+    turns.clear();
+    while (stage < DONE) {
+        // Generate the turns that are needed for this stage. Winning turns
+        // can't be generated separately, so if there are any, all turns are
+        // generated at once.
+        if (stage == WINS) {
+            if (may_win && !state->IsOver() && CanWinThisTurn(*state)) {
+                for (Group group : {ATTACK_GROUP, MOVE_GROUP, SUMMON_GROUP}) GenerateGroup(group);
+            }
+        } else if (stage == KILLS) {
+            GenerateGroup(ATTACK_GROUP);
+        } else if (stage == MOVES) {
+            GenerateGroup(MOVE_GROUP);
+        } else if (stage == SUMMONS) {
+            GenerateGroup(SUMMON_GROUP);
+        }
+
+        // Return turns of the current stage, and turns of earlier stages that
+        // were generated late. (This happens for turns that start with a
+        // summon, or for moves followed by a summon and an attack.) Turns of
+        // later stages that were generated early are kept until their stage.
+        for (int s = WINS; s <= stage; ++s) {
+            turns.insert(turns.end(), by_stage[s].begin(), by_stage[s].end());
+            by_stage[s].clear();
+        }
+        ++stage;
+        if (!turns.empty()) {
+            any_turns = true;
+            return true;
+        }
+    }
+    if (!any_turns) {
+        // Same as in GenerateTurns(): pass if there are no other turns.
+        any_turns = true;
+        turns.push_back(Turn{.naction=0, .actions={}});
+        return true;
+    }
+    return false;
 }
 
 // Executes an action in the given state.
@@ -950,6 +1305,16 @@ void ExecuteTurn(State &state, const Turn &turn) {
     state.EndTurn();
 }
 
+void ExecuteTurn(State &state, const Turn &turn, StateUndo &undo) {
+    state.StartRecording(undo);
+    ExecuteTurn(state, turn);
+    state.StopRecording();
+}
+
+void UndoTurn(State &state, const StateUndo &undo) {
+    state.Undo(undo);
+}
+
 std::string Action::ToString() const {
     std::ostringstream oss;
     oss << *this;
@@ -0,0 +1,59 @@
+#include "perft.h"
+
+#include <atomic>
+#include <cassert>
+#include <thread>
+
+namespace {
+
+// Recursive helper that executes turns in-place, and reuses turn buffers by
+// ply to avoid allocating memory.
+int64_t Perft(State &state, int depth, std::vector<std::vector<Turn>> &turns_by_ply, int ply) {
+    if (state.IsOver()) return depth == 0;
+    if (depth == 0) return 1;
+    std::vector<Turn> &turns = turns_by_ply[ply];
+    GenerateTurns(state, turns);
+    if (depth == 1) return turns.size();
+    int64_t count = 0;
+    for (const Turn &turn : turns) {
+        StateUndo undo;
+        ExecuteTurn(state, turn, undo);
+        count += Perft(state, depth - 1, turns_by_ply, ply + 1);
+        UndoTurn(state, undo);
+    }
+    return count;
+}
+
+}  // namespace
+
+int64_t Perft(const State &initial_state, int depth) {
+    assert(depth >= 0);
+    State state = initial_state;
+    std::vector<std::vector<Turn>> turns_by_ply(depth);
+    return Perft(state, depth, turns_by_ply, 0);
+}
+
+std::vector<PerftDivideResult> PerftDivide(const State &state, int depth, int threads) {
+    assert(depth >= 1 && threads >= 1);
+    std::vector<PerftDivideResult> results;
+    if (state.IsOver()) return results;
+    for (const Turn &turn : GenerateTurns(state)) {
+        results.push_back(PerftDivideResult{.turn = turn, .count = 0});
+    }
+
+    // Each worker repeatedly claims the next unprocessed root turn.
+    std::atomic<size_t> next_index = 0;
+    auto worker = [&]() {
+        std::vector<std::vector<Turn>> turns_by_ply(depth);
+        for (size_t i; (i = next_index++) < results.size(); ) {
+            State next_state = state;
+            ExecuteTurn(next_state, results[i].turn);
+            results[i].count = Perft(next_state, depth - 1, turns_by_ply, 0);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (int i = 1; i < threads; ++i) workers.emplace_back(worker);
+    worker();
+    for (std::thread &thread : workers) thread.join();
+    return results;
+}
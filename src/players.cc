@@ -1,6 +1,11 @@
 #include "players.h"
 
+#include "book.h"
+#include "eval.h"
+#include "tablebase.h"
+
 #include <charconv>
+#include <iostream>
 #include <map>
 #include <ranges>
 
@@ -56,6 +61,49 @@ std::optional<MinimaxPlayerOpts> ParseMinimaxOpts(const param_map_t &params) {
     for (const auto &[key, val] : params) {
         if (key == "max_depth") {
             if (std::from_chars(val.data(), val.data() + val.size(), res.max_depth).ec != std::errc{}) return {};
+        } else if (key == "max_time_ms") {
+            if (std::from_chars(val.data(), val.data() + val.size(), res.max_time_ms).ec != std::errc{}) return {};
+            if (res.max_time_ms < 0) return {};
+        } else if (key == "tt_mb") {
+            if (std::from_chars(val.data(), val.data() + val.size(), res.tt_mb).ec != std::errc{}) return {};
+            if (res.tt_mb < 0) return {};
+        } else if (key == "threads") {
+            if (std::from_chars(val.data(), val.data() + val.size(), res.threads).ec != std::errc{}) return {};
+            if (res.threads < 1) return {};
+        } else if (key == "weights") {
+            if (val.empty()) return {};
+            res.weights_file = val;
+        } else if (key == "ordering") {
+            if (val == "search") {
+                res.ordering = MinimaxPlayerOpts::SEARCH;
+            } else if (val == "heuristic") {
+                res.ordering = MinimaxPlayerOpts::HEURISTIC;
+            } else {
+                return {};
+            }
+        } else if (key == "pvs") {
+            res.pvs = true;
+        } else if (key == "aspiration_window") {
+            if (std::from_chars(val.data(), val.data() + val.size(), res.aspiration_window).ec != std::errc{}) return {};
+            if (res.aspiration_window < 0) return {};
+        } else if (key == "shuffle_root") {
+            res.shuffle_root = true;
+        } else if (key == "qsearch") {
+            res.qsearch = true;
+        } else if (key == "qsearch_depth") {
+            if (std::from_chars(val.data(), val.data() + val.size(), res.qsearch_depth).ec != std::errc{}) return {};
+            if (res.qsearch_depth < 1) return {};
+            res.qsearch = true;
+        } else if (key == "null_move") {
+            res.null_move = true;
+        } else if (key == "lmr") {
+            res.lmr = true;
+        } else if (key == "tablebase") {
+            if (val.empty()) return {};
+            res.tablebase_file = val;
+        } else if (key == "book") {
+            if (val.empty()) return {};
+            res.book_file = val;
         } else if (key == "experiment") {
             res.experiment = true;
         } else if (key == "verbose") {
@@ -68,8 +116,38 @@ std::optional<MinimaxPlayerOpts> ParseMinimaxOpts(const param_map_t &params) {
 }
 
 std::optional<MctsPlayerOpts> ParseMctsOpts(const param_map_t &params) {
-    if (!params.empty()) return {};
-    return MctsPlayerOpts{};
+    MctsPlayerOpts res = {};
+    for (const auto &[key, val] : params) {
+        if (key == "iterations") {
+            if (std::from_chars(val.data(), val.data() + val.size(), res.iterations).ec != std::errc{}) return {};
+            if (res.iterations < 1) return {};
+        } else if (key == "exploration") {
+            if (std::from_chars(val.data(), val.data() + val.size(), res.exploration).ec != std::errc{}) return {};
+            if (res.exploration < 0) return {};
+        } else if (key == "policy") {
+            if (val == "random") {
+                res.policy = MctsPlayerOpts::RANDOM;
+            } else if (val == "heavy") {
+                res.policy = MctsPlayerOpts::HEAVY;
+            } else {
+                return {};
+            }
+        } else if (key == "threads") {
+            if (std::from_chars(val.data(), val.data() + val.size(), res.threads).ec != std::errc{}) return {};
+            if (res.threads < 1) return {};
+        } else if (key == "tablebase") {
+            if (val.empty()) return {};
+            res.tablebase_file = val;
+        } else if (key == "book") {
+            if (val.empty()) return {};
+            res.book_file = val;
+        } else if (key == "verbose") {
+            res.verbose = true;
+        } else {
+            return {};  // Unknown key
+        }
+    }
+    return res;
 }
 
 }  // namespace
@@ -137,6 +215,41 @@ std::optional<PlayerDesc> ParsePlayerDesc(std::string_view sv) {
     return {};
 }
 
+namespace {
+
+// Checks that the files used by a minimax or MCTS player can be read.
+bool ValidateFiles(const std::string &weights_file, const std::string &tablebase_file, const std::string &book_file) {
+    if (!weights_file.empty() && !LoadEvalWeights(weights_file)) {
+        std::cerr << "Failed to load evaluation weights from " << weights_file << '\n';
+        return false;
+    }
+    if (!tablebase_file.empty() && !Tablebase::Open(tablebase_file)) {
+        std::cerr << "Failed to open tablebase " << tablebase_file << '\n';
+        return false;
+    }
+    if (!book_file.empty() && !OpeningBook::Open(book_file)) {
+        std::cerr << "Failed to open opening book " << book_file << '\n';
+        return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+bool ValidatePlayerDesc(const PlayerDesc &desc) {
+    switch (desc.type) {
+        case PLAY_RAND:
+        case PLAY_CLI:
+            return true;
+        case PLAY_MINIMAX:
+            return ValidateFiles(desc.opts.minimax.weights_file, desc.opts.minimax.tablebase_file,
+                    desc.opts.minimax.book_file);
+        case PLAY_MCTS:
+            return ValidateFiles({}, desc.opts.mcts.tablebase_file, desc.opts.mcts.book_file);
+    }
+    return false;
+}
+
 GamePlayer *CreatePlayerFromDesc(const PlayerDesc &desc) {
     switch (desc.type) {
         case PLAY_RAND:     return CreateRandomPlayer   (desc.opts.random);
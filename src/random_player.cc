@@ -13,10 +13,11 @@ public:
 private:
     bool verbose;
     rng_t rng;
+    std::vector<Turn> turns;
 };
 
 std::optional<Turn> RandomPlayer::SelectTurn(const State &state) {
-    std::vector<Turn> turns = GenerateTurns(state);
+    GenerateTurns(state, turns);
     assert(!turns.empty());
     Turn turn = Choose(rng, turns);
     if (verbose) std::cerr << "Randomly selected: " << turn << "\n";
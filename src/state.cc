@@ -46,7 +46,7 @@ std::span<const Dir> GetDirs(Dirs dirs) {
     }
 }
 
-const int8_t field_index_by_coords[BOARD_SIZE][BOARD_SIZE] = {
+constexpr int8_t field_index_by_coords[BOARD_SIZE][BOARD_SIZE] = {
     { -1, -1, -1, -1,  0, -1, -1, -1, -1 },
     { -1, -1, -1,  1,  2,  3, -1, -1, -1 },
     { -1, -1,  4,  5,  6,  7,  8, -1, -1 },
@@ -117,6 +117,70 @@ extern const size_t neighbors_index[FIELD_COUNT + 1] = {
      232, 237, 242, 248, 253, 256,
 };
 
+namespace {
+
+constexpr field_t ConstFieldIndex(int r, int c) {
+    return 0 <= r && r < BOARD_SIZE && 0 <= c && c < BOARD_SIZE
+        ? field_index_by_coords[r][c] : -1;
+}
+
+constexpr field_mask_t ConstStepMask(std::span<const Dir> dirs, int r, int c) {
+    field_mask_t mask = 0;
+    for (auto [dr, dc] : dirs) {
+        if (field_t i = ConstFieldIndex(r + dr, c + dc); i != -1) mask |= FieldMask(i);
+    }
+    return mask;
+}
+
+constexpr BoardMasks ComputeBoardMasks() {
+    BoardMasks masks = {};
+    for (int r = 0; r < BOARD_SIZE; ++r) for (int c = 0; c < BOARD_SIZE; ++c) {
+        field_t i = ConstFieldIndex(r, c);
+        if (i == -1) continue;
+
+        masks.step[ORTHOGONAL][i] = ConstStepMask(ortho_dirs, r, c);
+        masks.step[DIAGONAL  ][i] = ConstStepMask(diag_dirs, r, c);
+        masks.step[ALL8      ][i] = ConstStepMask(all8_dirs, r, c);
+        masks.step[KNIGHT    ][i] = ConstStepMask(knight_dirs, r, c);
+
+        for (int d = 0; d < DIR_COUNT; ++d) {
+            auto [dr, dc] = all8_dirs[d];
+            for (int n = 1; ConstFieldIndex(r + n*dr, c + n*dc) != -1; ++n) {
+                masks.ray[d][i] |= FieldMask(ConstFieldIndex(r + n*dr, c + n*dc));
+            }
+        }
+
+        for (int r2 = 0; r2 < BOARD_SIZE; ++r2) for (int c2 = 0; c2 < BOARD_SIZE; ++c2) {
+            if (field_t j = ConstFieldIndex(r2, c2); j != -1) {
+                int dist = std::max(r > r2 ? r - r2 : r2 - r, c > c2 ? c - c2 : c2 - c);
+                for (int d = dist; d < BOARD_SIZE; ++d) masks.distance[d][i] |= FieldMask(j);
+            }
+        }
+
+        for (int lo = 0; lo < BOARD_SIZE; ++lo) for (int hi = lo; hi < BOARD_SIZE; ++hi) {
+            if (lo <= r && r <= hi) masks.row_range[lo][hi] |= FieldMask(i);
+            if (lo <= c && c <= hi) masks.col_range[lo][hi] |= FieldMask(i);
+        }
+    }
+    return masks;
+}
+
+constexpr bool CheckAscendingDirs() {
+    for (int d = 0; d < DIR_COUNT; ++d) {
+        auto [dr, dc] = all8_dirs[d];
+        bool ascending = dr > 0 || (dr == 0 && dc > 0);
+        if (ascending != (((ascending_dirs >> d) & 1) != 0)) return false;
+    }
+    return true;
+}
+
+static_assert(CheckAscendingDirs());
+static_assert(all8_dirs[DIR_RIGHT].dr == 0 && all8_dirs[DIR_RIGHT].dc == +1);
+static_assert(all8_dirs[DIR_LEFT ].dr == 0 && all8_dirs[DIR_LEFT ].dc == -1);
+
+}  // namespace
+
+constexpr BoardMasks board_masks = ComputeBoardMasks();
 
 #define NO_DIRS     Dirs::NONE
 #define ORTHO       Dirs::ORTHOGONAL
@@ -143,6 +207,36 @@ constexpr GodInfo pantheon[GOD_COUNT] = {
 };
 
 
+static_assert([]{
+    for (const GodInfo &info : pantheon) if (info.hit > MAX_HIT_POINTS) return false;
+    return true;
+}());
+
+namespace {
+
+// SplitMix64 (see https://prng.di.unimi.it/splitmix64.c)
+constexpr uint64_t SplitMix64(uint64_t &x) {
+    uint64_t z = (x += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+constexpr ZobristKeys GenerateZobristKeys() {
+    ZobristKeys keys = {};
+    uint64_t seed = 20250101;
+    for (auto &a : keys.field) for (auto &b : a) for (auto &key : b) key = SplitMix64(seed);
+    for (auto &a : keys.hp) for (auto &b : a) for (auto &key : b) key = SplitMix64(seed);
+    for (auto &a : keys.chained) for (auto &key : a) key = SplitMix64(seed);
+    for (auto &a : keys.summonable) for (auto &key : a) key = SplitMix64(seed);
+    keys.dark_to_move = SplitMix64(seed);
+    return keys;
+}
+
+}  // namespace
+
+constexpr ZobristKeys zobrist_keys = GenerateZobristKeys();
+
 God GodById(char ch) {
     int i = 0;
     while (i < GOD_COUNT && pantheon[i].ascii_id != ch) ++i;
@@ -163,6 +257,9 @@ State State::InitialWithSummonable(std::array<god_mask_t, 2> summonable) {
         }
     }
     std::fill_n(state.fields, FIELD_COUNT, FieldState::UNOCCUPIED);
+    state.occupied[LIGHT] = state.occupied[DARK] = 0;
+    state.hash = state.ComputeHash();
+    state.eval_terms = state.ComputeEvalTerms();
     return state;
 }
 
@@ -260,57 +357,195 @@ std::optional<State> State::Decode(std::string_view sv) {
         }
     }
     if (pos != sv.size()) return {};  // unexpected trailing data
+    state.hash = state.ComputeHash();
+    state.eval_terms = state.ComputeEvalTerms();
+    return state;
+}
+
+// Binary state encoding
+//
+// States are encoded as a little-endian bit string of BINARY_SIZE bytes:
+//
+//  - bit 0: next player (0 for light, 1 for dark)
+//  - for each player
+//      - for each god: 10 bits
+//          0          dead
+//          1          summonable
+//          2          reserved (alive but not yet summonable)
+//          3 + x      alive and in play, where x = (field index * 10 +
+//                     hit points - 1) * 2 + chained (0/1)
+//  - remaining bits: 0
+//
+// This uses 1 + 24 * 10 = 241 bits, so it fits in 31 bytes; the last byte is
+// left for future use.
+
+namespace {
+
+constexpr int binary_god_bits = 10;
+constexpr unsigned binary_dead       = 0;
+constexpr unsigned binary_summonable = 1;
+constexpr unsigned binary_reserved   = 2;
+constexpr unsigned binary_in_play    = 3;
+
+static_assert(binary_in_play + FIELD_COUNT * MAX_HIT_POINTS * 2 <= (1u << binary_god_bits));
+static_assert(1 + 2 * GOD_COUNT * binary_god_bits <= 8 * State::BINARY_SIZE);
+
+}  // namespace
+
+void State::EncodeTo(std::span<uint8_t, BINARY_SIZE> out) const {
+    uint64_t bits = player;
+    int nbits = 1;
+    size_t pos = 0;
+    for (int p = 0; p < 2; ++p) {
+        for (int g = 0; g < GOD_COUNT; ++g) {
+            const GodState &gs = gods[p][g];
+            unsigned code =
+                gs.fi != -1 ? binary_in_play + (gs.fi * MAX_HIT_POINTS + gs.hp - 1) * 2 + (gs.fx & CHAINED) :
+                gs.hp == 0 ? binary_dead :
+                (summonable[p] & GodMask((God) g)) ? binary_summonable :
+                binary_reserved;
+            bits |= uint64_t{code} << nbits;
+            for (nbits += binary_god_bits; nbits >= 8; nbits -= 8) {
+                out[pos++] = static_cast<uint8_t>(bits);
+                bits >>= 8;
+            }
+        }
+    }
+    for (; pos < BINARY_SIZE; bits >>= 8) out[pos++] = static_cast<uint8_t>(bits);
+}
+
+// Unlike Decode(), this sets the fields directly and applies status effects
+// in a single pass afterwards, instead of calling Place() for each god, and
+// calculates the hash and evaluation terms along the way.
+std::optional<State> State::DecodeFrom(std::span<const uint8_t, BINARY_SIZE> in) {
+    State state;
+    state.player = static_cast<Player>(in[0] & 1);
+    state.summonable[LIGHT] = state.summonable[DARK] = 0;
+    std::fill_n(state.fields, FIELD_COUNT, FieldState::UNOCCUPIED);
+    state.occupied[LIGHT] = state.occupied[DARK] = 0;
+    state.hash = state.player == DARK ? zobrist_keys.dark_to_move : 0;
+    state.eval_terms = {};
+
+    uint64_t bits = in[0] >> 1;
+    int nbits = 7;
+    size_t pos = 1;
+    for (int p = 0; p < 2; ++p) {
+        for (int g = 0; g < GOD_COUNT; ++g) {
+            for (; nbits < binary_god_bits; nbits += 8) bits |= uint64_t{in[pos++]} << nbits;
+            unsigned code = bits & ((1u << binary_god_bits) - 1);
+            bits >>= binary_god_bits;
+            nbits -= binary_god_bits;
+
+            GodState &gs = state.gods[p][g];
+            gs = GodState{
+                .hp = code == binary_dead ? uint8_t{0} : pantheon[g].hit,
+                .fi = -1,
+                .fx = UNAFFECTED,
+            };
+            if (code == binary_summonable) {
+                state.summonable[p] |= GodMask((God) g);
+                state.hash ^= zobrist_keys.summonable[p][g];
+            } else if (code > binary_reserved) {
+                unsigned x = code - binary_in_play;
+                field_t fi = x / 2 / MAX_HIT_POINTS;
+                int hp = x / 2 % MAX_HIT_POINTS + 1;
+                if (fi >= FIELD_COUNT || hp > pantheon[g].hit || state.fields[fi].occupied) return {};
+                gs = GodState{
+                    .hp = static_cast<uint8_t>(hp),
+                    .fi = fi,
+                    .fx = (x & 1) ? CHAINED : UNAFFECTED,
+                };
+                state.fields[fi] = FieldState{
+                    .occupied = true,
+                    .player   = (Player) p,
+                    .god      = (God) g,
+                };
+                state.occupied[p] |= FieldMask(fi);
+                state.hash ^= zobrist_keys.field[p][g][fi];
+                if (x & 1) state.hash ^= zobrist_keys.chained[p][g];
+                state.eval_terms.gate_proximity[p] += GateProximity((Player) p, fi);
+            }
+            state.hash ^= zobrist_keys.hp[p][g][gs.hp];
+            state.eval_terms.hp[p] += gs.hp;
+        }
+    }
+    // Remaining bits must be zero.
+    if (bits != 0) return {};
+    for (; pos < BINARY_SIZE; ++pos) {
+        if (in[pos] != 0) return {};
+    }
+
+    // Apply auras of gods to their neighbors.
+    for (int p = 0; p < 2; ++p) {
+        for (int g = 0; g < GOD_COUNT; ++g) {
+            const StatusFx aura = pantheon[g].aura;
+            const field_t fi = state.gods[p][g].fi;
+            if (aura == UNAFFECTED || fi == -1) continue;
+            for (field_mask_t mask = StepMask(ALL8, fi) & state.occupied[p]; mask; ) {
+                GodState &ally = state.gods[p][state.fields[PopField(mask)].god];
+                ally.fx = static_cast<StatusFx>(ally.fx | aura);
+            }
+        }
+    }
+    assert(state.hash == state.ComputeHash());
+    assert(state.eval_terms == state.ComputeEvalTerms());
     return state;
 }
 
 void State::Place(Player player, God god, field_t field) {
     assert(!fields[field].occupied);
     assert(gods[player][god].fi == -1);
-    summonable[player] &= ~GodMask(god);
+    if (summonable[player] & GodMask(god)) {
+        summonable[player] &= ~GodMask(god);
+        hash ^= zobrist_keys.summonable[player][god];
+    }
     fields[field] = FieldState {
         .occupied = true,
         .player   = player,
         .god      = god,
     };
-    gods[player][god].fi = field;
+    occupied[player] |= FieldMask(field);
+    MutableGod(player, god).fi = field;
+    hash ^= zobrist_keys.field[player][god][field];
+    eval_terms.gate_proximity[player] += GateProximity(player, field);
+
+    const field_mask_t allies = StepMask(ALL8, field) & occupied[player];
 
     // Apply status effects from this god to neighbors:
     if (StatusFx aura = pantheon[god].aura; aura != UNAFFECTED) {
-        for (field_t f : Neighbors(field)) {
-            if (PlayerAt(f) == player) AddFx(player, GodAt(f), aura);
+        for (field_mask_t mask = allies; mask; ) {
+            AddFx(player, GodAt(PopField(mask)), aura);
         }
     }
 
     // Apply status effects from neighbors to this god:
-    for (field_t f : Neighbors(field)) {
-        if (PlayerAt(f) == player) {
-            if (StatusFx aura = pantheon[GodAt(f)].aura; aura != UNAFFECTED) {
-                AddFx(player, god, aura);
-            }
+    for (field_mask_t mask = allies; mask; ) {
+        if (StatusFx aura = pantheon[GodAt(PopField(mask))].aura; aura != UNAFFECTED) {
+            AddFx(player, god, aura);
         }
     }
 }
 
 void State::Remove(Player player, God god, field_t field) {
-    GodState &gs = gods[player][god];
-    gs.fi = -1;
-    gs.fx = UNAFFECTED,
+    SetFx(player, god, UNAFFECTED);
+    MutableGod(player, god).fi = -1;
+    hash ^= zobrist_keys.field[player][god][field];
+    eval_terms.gate_proximity[player] -= GateProximity(player, field);
     fields[field] = FieldState::UNOCCUPIED;
+    occupied[player] &= ~FieldMask(field);
 
     // Remove status effects conferred by this god:
     if (StatusFx aura = pantheon[god].aura; aura != UNAFFECTED) {
-        for (field_t f : Neighbors(field)) {
-            if (PlayerAt(f) == player) RemoveFx(player, GodAt(f), aura);
+        for (field_mask_t mask = StepMask(ALL8, field) & occupied[player]; mask; ) {
+            RemoveFx(player, GodAt(PopField(mask)), aura);
         }
     }
 
     // When Hades is removed, remove CHAINED effect from adjacent enemies.
     if (god == HADES) {
         Player opponent = Other(player);
-        for (field_t f : Neighbors(field)) {
-            if (PlayerAt(f) == opponent) {
-                Unchain(opponent, GodAt(f));
-            }
+        for (field_mask_t mask = StepMask(ALL8, field) & occupied[opponent]; mask; ) {
+            Unchain(opponent, GodAt(PopField(mask)));
         }
     }
 }
@@ -320,12 +555,15 @@ void State::Move(Player player, God god, field_t dst) {
 
     Unchain(player, god); // moving always removes Hades chain
 
-    GodState &gs = gods[player][god];
+    GodState &gs = MutableGod(player, god);
     field_t src = gs.fi;
     assert(src != -1);
     gs.fi = dst;
+    hash ^= zobrist_keys.field[player][god][src] ^ zobrist_keys.field[player][god][dst];
+    eval_terms.gate_proximity[player] += GateProximity(player, dst) - GateProximity(player, src);
     fields[dst] = fields[src];
     fields[src] = FieldState::UNOCCUPIED;
+    occupied[player] ^= FieldMask(src) | FieldMask(dst);
 
     // Update status effects by iterating neighboring fields that
     // are removed and neighboring fields that are added.
@@ -362,9 +600,9 @@ void State::Move(Player player, God god, field_t dst) {
 
 void State::DealDamage(Player player, God god, int damage) {
     assert(fi(player, god) != -1);
-    auto &hp = gods[player][god].hp;
+    int hp = gods[player][god].hp;
     if (hp > damage) {
-        hp -= damage;
+        SetHp(player, god, hp - damage);
     } else {
         Kill(player, god);
     }
@@ -372,19 +610,80 @@ void State::DealDamage(Player player, God god, int damage) {
 
 void State::Kill(Player player, God god) {
     field_t field = fi(player, god);
-    gods[player][god].hp = 0;
+    SetHp(player, god, 0);
     Remove(player, god, field);
 }
 
+void State::Undo(const StateUndo &undo) {
+    assert(recorder.undo == nullptr);
+    player = undo.player;
+    summonable[LIGHT] = undo.summonable[LIGHT];
+    summonable[DARK]  = undo.summonable[DARK];
+    hash = undo.hash;
+    eval_terms = undo.eval_terms;
+
+    // Take all modified gods off the board first, and then put them back at
+    // their original fields, since gods may have swapped places.
+    for (uint32_t mask = undo.saved_gods; mask; mask &= mask - 1) {
+        int i = std::countr_zero(mask);
+        Player p = AsPlayer(i / GOD_COUNT);
+        God    g = AsGod(i % GOD_COUNT);
+        if (field_t f = gods[p][g].fi; f != -1) {
+            fields[f] = FieldState::UNOCCUPIED;
+            occupied[p] &= ~FieldMask(f);
+        }
+    }
+    for (uint32_t mask = undo.saved_gods; mask; mask &= mask - 1) {
+        int i = std::countr_zero(mask);
+        Player p = AsPlayer(i / GOD_COUNT);
+        God    g = AsGod(i % GOD_COUNT);
+        gods[p][g] = undo.gods[p][g];
+        if (field_t f = gods[p][g].fi; f != -1) {
+            fields[f] = FieldState{
+                .occupied = true,
+                .player   = p,
+                .god      = g,
+            };
+            occupied[p] |= FieldMask(f);
+        }
+    }
+}
+
 void State::SetHpForTest(Player player, God god, int hp) {
     assert(0 < hp && hp <= pantheon[god].hit);
-    gods[player][god].hp = hp;
+    SetHp(player, god, hp);
 }
 
 void State::DecHpForTest(Player player, God god, int dmg) {
     SetHpForTest(player, god, hp(player, god) - dmg);
 }
 
+uint64_t State::ComputeHash() const {
+    uint64_t res = player == DARK ? zobrist_keys.dark_to_move : 0;
+    for (int p = 0; p < 2; ++p) {
+        for (int g = 0; g < GOD_COUNT; ++g) {
+            const GodState &gs = gods[p][g];
+            res ^= zobrist_keys.hp[p][g][gs.hp];
+            if (gs.fi != -1) res ^= zobrist_keys.field[p][g][gs.fi];
+            if (gs.fx & CHAINED) res ^= zobrist_keys.chained[p][g];
+            if (summonable[p] & GodMask((God) g)) res ^= zobrist_keys.summonable[p][g];
+        }
+    }
+    return res;
+}
+
+EvalTerms State::ComputeEvalTerms() const {
+    EvalTerms res = {};
+    for (int p = 0; p < 2; ++p) {
+        for (int g = 0; g < GOD_COUNT; ++g) {
+            const GodState &gs = gods[p][g];
+            res.hp[p] += gs.hp;
+            if (gs.fi != -1) res.gate_proximity[p] += GateProximity(AsPlayer(p), gs.fi);
+        }
+    }
+    return res;
+}
+
 god_mask_t State::PlayerGods(Player player) const {
     god_mask_t mask = summonable[player];
     for (int god = 0; god < GOD_COUNT; ++god) {
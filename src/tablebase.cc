@@ -0,0 +1,452 @@
+#include "tablebase.h"
+
+#include "moves.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <vector>
+
+namespace {
+
+// File layout: a FileHeader, followed by `table_count` TableHeaders, followed
+// by the tables. All integers are stored in native byte order.
+constexpr char file_magic[8] = {'M', 'Y', 'T', 'K', 'T', 'B', 'L', 'S'};
+constexpr uint32_t file_version = 1;
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t table_count;
+};
+
+struct TableHeader {
+    uint32_t key;  // Material::Key()
+    uint32_t reserved;
+    uint64_t offset;  // from the start of the file
+    uint64_t size;
+};
+
+static_assert(sizeof(FileHeader) == 16);
+static_assert(sizeof(TableHeader) == 24);
+
+// Tables are aligned to this many bytes in the file.
+constexpr uint64_t table_alignment = 8;
+
+// Each table entry is one byte:
+//
+//   0:       draw (or not yet known, during generation)
+//   1-254:   the number of turns until the game is won; odd if the next
+//            player wins, even if they lose
+//   255:     illegal position (two gods on the same field, a god on the enemy
+//            gate, or a chained god that is not next to enemy Hades)
+//
+constexpr uint8_t value_draw = 0;
+constexpr uint8_t value_illegal = 255;
+constexpr int max_turns = 254;
+
+// Generation fails for tables with more positions than fit in the 32-bit
+// index of a successor reference (see Generator), or that need more memory
+// than this for the table and the successor lists.
+constexpr uint64_t max_table_size = uint64_t{1} << 32;
+constexpr uint64_t max_generation_memory = uint64_t{16} << 30;
+
+// Describes how positions of a material are indexed: as a mixed-radix number
+// made up of the field of each god, the hit points of each god, whether each
+// god is chained (only for gods whose opponent has Hades in play), and the
+// next player, from most to least significant.
+struct Layout {
+    int count = 0;
+    Player players[2 * GOD_COUNT];
+    God gods[2 * GOD_COUNT];
+    bool chainable[2 * GOD_COUNT];
+    uint64_t size = 0;
+};
+
+Layout MakeLayout(const Material &material) {
+    Layout layout;
+    layout.size = 2;
+    for (Player player : {LIGHT, DARK}) {
+        bool chainable = (material.gods[Other(player)] & GodMask(HADES)) != 0;
+        for (int g = 0; g < GOD_COUNT; ++g) {
+            God god = static_cast<God>(g);
+            if ((material.gods[player] & GodMask(god)) == 0) continue;
+            int i = layout.count++;
+            layout.players[i] = player;
+            layout.gods[i] = god;
+            layout.chainable[i] = chainable;
+            layout.size *= FIELD_COUNT * pantheon[god].hit * (chainable ? 2 : 1);
+        }
+    }
+    return layout;
+}
+
+// The state must have exactly the gods of the layout's material in play.
+uint64_t IndexOf(const Layout &layout, const State &state) {
+    uint64_t index = 0;
+    for (int i = 0; i < layout.count; ++i) {
+        index = index * FIELD_COUNT + state.fi(layout.players[i], layout.gods[i]);
+    }
+    for (int i = 0; i < layout.count; ++i) {
+        index = index * pantheon[layout.gods[i]].hit + state.hp(layout.players[i], layout.gods[i]) - 1;
+    }
+    for (int i = 0; i < layout.count; ++i) {
+        if (!layout.chainable[i]) continue;
+        index = index * 2 + state.has_fx(layout.players[i], layout.gods[i], CHAINED);
+    }
+    return index * 2 + state.NextPlayer();
+}
+
+// Inverse of IndexOf(). Returns nothing if the index describes an illegal
+// position (see value_illegal above).
+std::optional<State> StateAt(const Layout &layout, uint64_t index) {
+    Player player = static_cast<Player>(index % 2);
+    index /= 2;
+    bool chained[2 * GOD_COUNT] = {};
+    for (int i = layout.count - 1; i >= 0; --i) {
+        if (!layout.chainable[i]) continue;
+        chained[i] = index % 2;
+        index /= 2;
+    }
+    int hp[2 * GOD_COUNT];
+    for (int i = layout.count - 1; i >= 0; --i) {
+        int hit = pantheon[layout.gods[i]].hit;
+        hp[i] = index % hit + 1;
+        index /= hit;
+    }
+    field_t fields[2 * GOD_COUNT];
+    for (int i = layout.count - 1; i >= 0; --i) {
+        fields[i] = index % FIELD_COUNT;
+        index /= FIELD_COUNT;
+    }
+
+    State state = State::InitialNoneSummonable();
+    for (int i = 0; i < layout.count; ++i) {
+        if (state.IsOccupied(fields[i])) return {};
+        state.Place(layout.players[i], layout.gods[i], fields[i]);
+        int damage = pantheon[layout.gods[i]].hit - hp[i];
+        if (damage > 0) state.DealDamage(layout.players[i], layout.gods[i], damage);
+    }
+    if (state.IsOver()) return {};
+    for (int i = 0; i < layout.count; ++i) {
+        if (!chained[i]) continue;
+        field_t hades = state.fi(Other(layout.players[i]), HADES);
+        if (!(StepMask(ALL8, fields[i]) & FieldMask(hades))) return {};
+        state.Chain(layout.players[i], layout.gods[i]);
+    }
+    if (player != state.NextPlayer()) state.EndTurn();
+    return state;
+}
+
+std::optional<TablebaseResult> ResultOf(uint8_t value) {
+    if (value == value_illegal) return {};
+    if (value == value_draw) return TablebaseResult{.outcome = 0, .turns = 0};
+    return TablebaseResult{.outcome = value % 2 ? 1 : -1, .turns = value};
+}
+
+// Calculates tables in order of increasing material size, so that the
+// positions reached by killing a god are always found in an earlier table.
+//
+// Each table is solved by forward iteration: in pass n, positions that have
+// a successor in which the opponent loses in n - 1 turns are won in n turns
+// (n odd), and positions in which all successors are won by the opponent in
+// less than n turns are lost in n turns (n even). The successors of each
+// position are generated once, in the first pass. Positions that are not
+// solved when no more progress can be made are draws.
+class Generator {
+public:
+    // Returns false if the table is too large (see max_table_size and
+    // max_generation_memory). An error is printed in that case.
+    bool Generate(const Material &material, std::ostream *log);
+
+    bool Write(const std::string &path) const;
+
+private:
+    // Reference to a table entry: the table number in the upper 32 bits, and
+    // the index in the lower 32 bits. draw_ref refers to a draw without a
+    // table (when no gods are left in play).
+    using ref_t = uint64_t;
+    static constexpr ref_t draw_ref = ~ref_t{0};
+
+    uint8_t Value(ref_t ref) const {
+        return ref == draw_ref ? value_draw : tables[ref >> 32].values[ref & 0xffffffff];
+    }
+
+    struct Table {
+        Material material;
+        Layout layout;
+        std::vector<uint8_t> values;
+    };
+
+    std::vector<Table> tables;
+    std::map<uint32_t, size_t> table_by_key;
+};
+
+bool Generator::Generate(const Material &material, std::ostream *log) {
+    const Layout layout = MakeLayout(material);
+    const uint64_t size = layout.size;
+    // The table itself, and the start of the successor list of each position.
+    const uint64_t fixed_memory = size * (sizeof(uint8_t) + sizeof(uint64_t));
+    if (size > max_table_size || fixed_memory > max_generation_memory) {
+        std::cerr << "Table for " << material.ToString() << " is too large (" << size << " positions)\n";
+        return false;
+    }
+
+    const size_t table_number = tables.size();
+    Table &table = tables.emplace_back(Table{
+        .material = material,
+        .layout = layout,
+        .values = {},
+    });
+    table_by_key[material.Key()] = table_number;
+    table.values.assign(size, value_illegal);
+
+    // Pass 1: find positions that are won immediately, and the successors of
+    // all other positions, as sorted lists of references without duplicates.
+    std::vector<uint64_t> begin(size + 1);
+    std::vector<ref_t> successors;
+    std::vector<Turn> turns;
+    int max_successor_turns = 0;
+    for (uint64_t index = 0; index < size; ++index) {
+        begin[index] = successors.size();
+        std::optional<State> state = StateAt(table.layout, index);
+        if (!state) continue;
+        table.values[index] = value_draw;
+        GenerateTurns(*state, turns);
+        for (const Turn &turn : turns) {
+            State next = *state;
+            ExecuteTurn(next, turn);
+            if (next.IsOver()) {
+                assert(next.Winner() == state->NextPlayer());
+                table.values[index] = 1;
+                break;
+            }
+            Material next_material = Material::Of(next);
+            if (next_material.Count() == 0) {
+                successors.push_back(draw_ref);
+                continue;
+            }
+            auto it = table_by_key.find(next_material.Key());
+            assert(it != table_by_key.end());
+            const Table &next_table = tables[it->second];
+            ref_t ref = ref_t{it->second} << 32 | IndexOf(next_table.layout, next);
+            successors.push_back(ref);
+            if (it->second != table_number) {
+                max_successor_turns = std::max<int>(max_successor_turns, next_table.values[ref & 0xffffffff]);
+            }
+        }
+        if (fixed_memory + successors.size() * sizeof(ref_t) > max_generation_memory) {
+            std::cerr << "Table for " << material.ToString() << " needs more than "
+                << (max_generation_memory >> 30) << " GB of memory to generate\n";
+            return false;
+        }
+        if (table.values[index] != value_draw) {
+            successors.resize(begin[index]);
+        } else {
+            auto first = successors.begin() + begin[index];
+            std::sort(first, successors.end());
+            successors.erase(std::unique(first, successors.end()), successors.end());
+        }
+    }
+    begin[size] = successors.size();
+
+    // Later passes: see the class comment.
+    int passes_without_progress = 0;
+    for (int n = 2; n <= max_turns; ++n) {
+        bool progress = false;
+        for (uint64_t index = 0; index < size; ++index) {
+            if (table.values[index] != value_draw) continue;
+            bool resolved = n % 2 == 0;
+            for (uint64_t i = begin[index]; i < begin[index + 1]; ++i) {
+                uint8_t value = Value(successors[i]);
+                assert(value != value_illegal);
+                bool known = value != value_draw && value < n;
+                if (n % 2 == 1 && known && value % 2 == 0) {
+                    resolved = true;
+                    break;
+                }
+                if (n % 2 == 0 && !(known && value % 2 == 1)) {
+                    resolved = false;
+                    break;
+                }
+            }
+            if (resolved) {
+                table.values[index] = n;
+                progress = true;
+            }
+        }
+        passes_without_progress = progress ? 0 : passes_without_progress + 1;
+        if (passes_without_progress >= 2 && n > max_successor_turns + 1) break;
+        if (n == max_turns && log) {
+            *log << "Warning: stopped after " << max_turns << " turns; remaining positions are marked as draws\n";
+        }
+    }
+
+    if (log) {
+        uint64_t wins = 0, losses = 0, draws = 0;
+        int longest = 0;
+        for (uint8_t value : table.values) {
+            if (value == value_illegal) continue;
+            if (value == value_draw) {
+                ++draws;
+            } else {
+                ++(value % 2 ? wins : losses);
+                longest = std::max<int>(longest, value);
+            }
+        }
+        *log << material.ToString() << ": " << wins << " wins, " << losses << " losses, "
+            << draws << " draws, longest " << longest << " turns\n";
+    }
+    return true;
+}
+
+bool Generator::Write(const std::string &path) const {
+    std::ofstream ofs(path, std::ios::binary);
+    if (!ofs) return false;
+
+    FileHeader header = {};
+    std::memcpy(header.magic, file_magic, sizeof(file_magic));
+    header.version = file_version;
+    header.table_count = tables.size();
+    ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    uint64_t offset = sizeof(FileHeader) + tables.size() * sizeof(TableHeader);
+    for (const Table &table : tables) {
+        offset = (offset + table_alignment - 1) / table_alignment * table_alignment;
+        TableHeader table_header = {
+            .key = table.material.Key(),
+            .reserved = 0,
+            .offset = offset,
+            .size = table.values.size(),
+        };
+        ofs.write(reinterpret_cast<const char *>(&table_header), sizeof(table_header));
+        offset += table.values.size();
+    }
+
+    offset = sizeof(FileHeader) + tables.size() * sizeof(TableHeader);
+    for (const Table &table : tables) {
+        static constexpr char padding[table_alignment] = {};
+        uint64_t aligned = (offset + table_alignment - 1) / table_alignment * table_alignment;
+        ofs.write(padding, aligned - offset);
+        ofs.write(reinterpret_cast<const char *>(table.values.data()), table.values.size());
+        offset = aligned + table.values.size();
+    }
+    return bool(ofs.flush());
+}
+
+}  // namespace
+
+Material Material::Of(const State &state) {
+    Material material = {};
+    for (Player player : {LIGHT, DARK}) {
+        for (field_mask_t mask = state.Occupied(player); mask; ) {
+            material.gods[player] |= GodMask(state.GodAt(PopField(mask)));
+        }
+    }
+    return material;
+}
+
+std::optional<Material> Material::Parse(std::string_view sv) {
+    std::string_view::size_type sep = sv.find('/');
+    if (sep == std::string_view::npos) return {};
+    Material material = {};
+    for (Player player : {LIGHT, DARK}) {
+        std::string_view ids = player == LIGHT ? sv.substr(0, sep) : sv.substr(sep + 1);
+        for (char ch : ids) {
+            God god = GodById(ch);
+            if (god == GOD_COUNT || (material.gods[player] & GodMask(god))) return {};
+            material.gods[player] |= GodMask(god);
+        }
+    }
+    return material;
+}
+
+std::string Material::ToString() const {
+    std::string s;
+    for (Player player : {LIGHT, DARK}) {
+        if (player == DARK) s += '/';
+        for (int g = 0; g < GOD_COUNT; ++g) {
+            if (gods[player] & GodMask(static_cast<God>(g))) s += pantheon[g].ascii_id;
+        }
+    }
+    return s;
+}
+
+int Material::Count() const {
+    return std::popcount(gods[LIGHT]) + std::popcount(gods[DARK]);
+}
+
+std::unique_ptr<Tablebase> Tablebase::Open(const std::string &path) {
+    std::unique_ptr<MappedFile> file = MappedFile::Open(path);
+    if (!file) return nullptr;
+    const std::span<const uint8_t> data = file->Data();
+    if (data.size() < sizeof(FileHeader)) return nullptr;
+    std::unique_ptr<Tablebase> tablebase(new Tablebase(std::move(file)));
+
+    FileHeader header;
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (std::memcmp(header.magic, file_magic, sizeof(file_magic)) != 0 ||
+            header.version != file_version ||
+            header.table_count > (data.size() - sizeof(FileHeader)) / sizeof(TableHeader)) {
+        return nullptr;
+    }
+    for (uint32_t i = 0; i < header.table_count; ++i) {
+        TableHeader table_header;
+        std::memcpy(&table_header, data.data() + sizeof(FileHeader) + i * sizeof(TableHeader), sizeof(table_header));
+        Material material = {{
+            static_cast<god_mask_t>(table_header.key & 0xffff),
+            static_cast<god_mask_t>(table_header.key >> 16),
+        }};
+        if ((material.gods[LIGHT] & ~ALL_GODS) || (material.gods[DARK] & ~ALL_GODS) ||
+                material.Count() == 0 || material.Key() != table_header.key ||
+                table_header.size != MakeLayout(material).size ||
+                table_header.offset > data.size() || table_header.size > data.size() - table_header.offset) {
+            return nullptr;
+        }
+        tablebase->tables[table_header.key] = data.subspan(table_header.offset, table_header.size);
+        tablebase->max_gods = std::max(tablebase->max_gods, material.Count());
+    }
+    return tablebase;
+}
+
+std::optional<TablebaseResult> Tablebase::Probe(const State &state) const {
+    assert(!state.IsOver());
+    if (state.Summonable(LIGHT) || state.Summonable(DARK)) return {};
+    if (std::popcount(state.Occupied()) > max_gods) return {};
+    Material material = Material::Of(state);
+    auto it = tables.find(material.Key());
+    if (it == tables.end()) return {};
+    return ResultOf(it->second[IndexOf(MakeLayout(material), state)]);
+}
+
+bool GenerateTablebase(std::span<const Material> materials, const std::string &path, std::ostream *log) {
+    // Add all materials that can be reached by killing gods, ordered by size.
+    std::vector<Material> all;
+    for (const Material &material : materials) {
+        for (god_mask_t light = material.gods[LIGHT]; ; light = (light - 1) & material.gods[LIGHT]) {
+            for (god_mask_t dark = material.gods[DARK]; ; dark = (dark - 1) & material.gods[DARK]) {
+                if (light || dark) all.push_back(Material{{light, dark}});
+                if (dark == 0) break;
+            }
+            if (light == 0) break;
+        }
+    }
+    std::sort(all.begin(), all.end(), [](const Material &a, const Material &b) {
+        return a.Count() != b.Count() ? a.Count() < b.Count() : a.Key() < b.Key();
+    });
+    all.erase(std::unique(all.begin(), all.end()), all.end());
+
+    Generator generator;
+    for (const Material &material : all) {
+        if (!generator.Generate(material, log)) return false;
+    }
+    if (!generator.Write(path)) {
+        std::cerr << "Failed to write " << path << '\n';
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,166 @@
+#include "transposition_table.h"
+
+#include <bit>
+#include <cassert>
+
+namespace {
+
+static_assert(FIELD_COUNT <= 64);
+static_assert(GOD_COUNT <= 16);
+static_assert(Turn::MAX_ACTION == 6);
+
+// Each action is packed into 12 bits: 2 bits for the type, 4 bits for the god
+// and 6 bits for the field.
+constexpr int action_bits = 12;
+
+uint64_t PackAction(const Action &action) {
+    assert(action.field >= 0 && action.field < FIELD_COUNT);
+    return (action.type << 10) | (action.god << 6) | action.field;
+}
+
+Action UnpackAction(uint64_t bits) {
+    return Action{
+        .type  = static_cast<Action::Type>((bits >> 10) & 3),
+        .god   = static_cast<God>((bits >> 6) & 15),
+        .field = static_cast<field_t>(bits & 63),
+    };
+}
+
+// Layout of the data word:
+//
+//   bits  0-31: score
+//   bits 32-39: depth
+//   bits 40-41: bound
+//   bits 42-47: generation
+//   bits 48-50: number of actions in the best turn
+//   bits 51-62: sixth action of the best turn
+//
+// The turn word contains the first five actions of the best turn.
+struct Unpacked {
+    int score;
+    int depth;
+    Bound bound;
+    int generation;
+};
+
+Unpacked UnpackData(uint64_t data) {
+    return Unpacked{
+        .score      = static_cast<int32_t>(static_cast<uint32_t>(data)),
+        .depth      = static_cast<int>((data >> 32) & 255),
+        .bound      = static_cast<Bound>((data >> 40) & 3),
+        .generation = static_cast<int>((data >> 42) & 63),
+    };
+}
+
+Turn UnpackTurn(uint64_t data, uint64_t turn_bits) {
+    Turn turn = {};
+    turn.naction = (data >> 48) & 7;
+    for (int i = 0; i < turn.naction; ++i) {
+        uint64_t bits = i < 5 ? turn_bits >> (action_bits * i) : data >> 51;
+        turn.actions[i] = UnpackAction(bits & ((1 << action_bits) - 1));
+    }
+    return turn;
+}
+
+}  // namespace
+
+TranspositionTable::TranspositionTable(size_t size_mb) {
+    size_t max_buckets = (size_mb << 20) / sizeof(Bucket);
+    if (max_buckets > 0) {
+        bucket_count = std::bit_floor(max_buckets);
+        buckets.reset(new Bucket[bucket_count]());
+    }
+}
+
+void TranspositionTable::Clear() {
+    for (size_t i = 0; i < bucket_count; ++i) {
+        for (Slot &slot : buckets[i].slots) {
+            slot.check.store(0, std::memory_order_relaxed);
+            slot.data.store(0, std::memory_order_relaxed);
+            slot.turn.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+bool TranspositionTable::Probe(uint64_t key, TranspositionEntry &entry) const {
+    if (!Enabled()) return false;
+    for (const Slot &slot : BucketFor(key).slots) {
+        uint64_t check = slot.check.load(std::memory_order_relaxed);
+        uint64_t data  = slot.data.load(std::memory_order_relaxed);
+        uint64_t turn  = slot.turn.load(std::memory_order_relaxed);
+        if ((check ^ data ^ turn) != key) continue;
+        Unpacked unpacked = UnpackData(data);
+        if (unpacked.bound == Bound::NONE) continue;
+        entry.score = unpacked.score;
+        entry.depth = unpacked.depth;
+        entry.bound = unpacked.bound;
+        entry.best_turn = UnpackTurn(data, turn);
+        return true;
+    }
+    return false;
+}
+
+void TranspositionTable::Store(uint64_t key, int depth, Bound bound, int score, const Turn *best_turn) {
+    if (!Enabled()) return;
+    assert(depth >= 0 && depth <= 255);
+    Bucket &bucket = BucketFor(key);
+
+    // Select a slot to replace: prefer the slot with the same key, then an
+    // empty slot, then a slot from an old search, then the shallowest slot.
+    Slot *dst = nullptr;
+    int dst_priority = -1;
+    bool same_key = false;
+    Unpacked old = {};
+    uint64_t old_data = 0, old_turn = 0;
+    for (Slot &slot : bucket.slots) {
+        uint64_t check = slot.check.load(std::memory_order_relaxed);
+        uint64_t data  = slot.data.load(std::memory_order_relaxed);
+        uint64_t turn  = slot.turn.load(std::memory_order_relaxed);
+        Unpacked unpacked = UnpackData(data);
+        bool valid = unpacked.bound != Bound::NONE;
+        bool match = valid && (check ^ data ^ turn) == key;
+        int priority =
+            match ? 1000 :
+            !valid ? 999 :
+            unpacked.generation != generation ? 500 - unpacked.depth :
+            255 - unpacked.depth;
+        if (priority > dst_priority) {
+            dst = &slot;
+            dst_priority = priority;
+            same_key = match;
+            old = unpacked;
+            old_data = data;
+            old_turn = turn;
+        }
+    }
+
+    uint64_t turn_bits = 0;
+    uint64_t data = static_cast<uint32_t>(score)
+        | static_cast<uint64_t>(depth) << 32
+        | static_cast<uint64_t>(bound) << 40
+        | static_cast<uint64_t>(generation) << 42;
+    if (same_key) {
+        // Don't overwrite a deeper result for the same state from this search
+        // with a shallower one, unless the new result is exact.
+        if (old.generation == generation && old.depth > depth && bound != Bound::EXACT) return;
+        if (best_turn == nullptr) {
+            // Keep the previous best turn.
+            data |= old_data & (uint64_t{0x7fff} << 48);
+            turn_bits = old_turn;
+        }
+    }
+    if (best_turn != nullptr) {
+        data |= static_cast<uint64_t>(best_turn->naction) << 48;
+        for (int i = 0; i < best_turn->naction; ++i) {
+            uint64_t bits = PackAction(best_turn->actions[i]);
+            if (i < 5) {
+                turn_bits |= bits << (action_bits * i);
+            } else {
+                data |= bits << 51;
+            }
+        }
+    }
+    dst->check.store(key ^ data ^ turn_bits, std::memory_order_relaxed);
+    dst->data.store(data, std::memory_order_relaxed);
+    dst->turn.store(turn_bits, std::memory_order_relaxed);
+}
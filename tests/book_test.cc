@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+
+#include "book.h"
+#include "moves.h"
+#include "state.h"
+
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+
+// Returns a path that is unique per process, since tests may run concurrently.
+std::string TempPath(const std::string &name) {
+    return testing::TempDir() + "book_test." + std::to_string(getpid()) + "." + name;
+}
+
+}  // namespace
+
+TEST(OpeningBookTest, WriteAndLookup) {
+    // One entry for the initial state and each state after the first turn,
+    // each with the last valid turn in that state.
+    State initial = State::InitialAllSummonable();
+    std::vector<State> states = {initial};
+    for (const Turn &turn : GenerateTurns(initial)) {
+        State next = initial;
+        ExecuteTurn(next, turn);
+        states.push_back(next);
+    }
+    std::vector<std::pair<uint64_t, Turn>> entries;
+    for (const State &state : states) entries.emplace_back(state.Hash(), GenerateTurns(state).back());
+
+    std::string path = TempPath("book");
+    ASSERT_TRUE(WriteOpeningBook(path, entries));
+    std::unique_ptr<OpeningBook> book = OpeningBook::Open(path);
+    std::remove(path.c_str());
+    ASSERT_NE(book, nullptr);
+
+    // Different turns may lead to the same state, which is stored once.
+    std::set<uint64_t> hashes;
+    for (const State &state : states) hashes.insert(state.Hash());
+    EXPECT_EQ(book->Size(), hashes.size());
+    for (const State &state : states) {
+        std::optional<Turn> turn = book->Lookup(state);
+        ASSERT_TRUE(turn.has_value()) << state.Encode();
+        EXPECT_EQ(*turn, GenerateTurns(state).back()) << state.Encode();
+    }
+
+    State other = State::InitialNoneSummonable();
+    other.Place(LIGHT, ZEUS, 10);
+    EXPECT_FALSE(book->Lookup(other));
+}
+
+TEST(OpeningBookTest, LookupRejectsInvalidTurns) {
+    State state = State::InitialAllSummonable();
+    Turn invalid = {};
+    invalid.naction = 1;
+    invalid.actions[0] = Action{.type = Action::MOVE, .god = ZEUS, .field = 20};
+    std::vector<std::pair<uint64_t, Turn>> entries = {{state.Hash(), invalid}};
+
+    std::string path = TempPath("invalid_turn");
+    ASSERT_TRUE(WriteOpeningBook(path, entries));
+    std::unique_ptr<OpeningBook> book = OpeningBook::Open(path);
+    std::remove(path.c_str());
+    ASSERT_NE(book, nullptr);
+    EXPECT_EQ(book->Size(), 1);
+    EXPECT_FALSE(book->Lookup(state));
+}
+
+TEST(OpeningBookTest, OpenFailsForInvalidFiles) {
+    EXPECT_EQ(OpeningBook::Open(TempPath("does_not_exist")), nullptr);
+
+    std::string path = TempPath("invalid_file");
+    std::ofstream(path) << "This is not an opening book.";
+    EXPECT_EQ(OpeningBook::Open(path), nullptr);
+    std::remove(path.c_str());
+}
@@ -0,0 +1,56 @@
+#include <gtest/gtest.h>
+
+#include "eval.h"
+#include "moves.h"
+#include "random_games.h"
+#include "state.h"
+
+#include <sstream>
+#include <vector>
+
+namespace {
+
+int DotProduct(const EvalWeights &weights, const EvalFeatures &features) {
+    int res = 0;
+    for (int i = 0; i < EVAL_TERM_COUNT; ++i) res += weights[i] * features[i];
+    return res;
+}
+
+TEST(EvalTest, EvaluateMatchesFeatures) {
+    // Plays random games and checks that Evaluate() equals the weighted sum of
+    // the features, both with and without gate threat and status effect terms.
+    const EvalWeights weights = {7, 5, 17, -3, 2, 11, 13};
+    ForEachRandomGameState([&weights](const State &state, const std::vector<Turn> &) {
+        EvalFeatures features = GetEvalFeatures(state);
+        EXPECT_EQ(Evaluate(state, default_eval_weights), DotProduct(default_eval_weights, features));
+        EXPECT_EQ(Evaluate(state, weights), DotProduct(weights, features));
+    });
+}
+
+TEST(EvalTest, ParseEvalWeights) {
+    std::istringstream iss("# comment\n\nchained -10\nhp 500\n");
+    std::optional<EvalWeights> weights = ParseEvalWeights(iss);
+    ASSERT_TRUE(weights);
+    EvalWeights expected = default_eval_weights;
+    expected[EVAL_CHAINED] = -10;
+    expected[EVAL_HP] = 500;
+    EXPECT_EQ(*weights, expected);
+}
+
+TEST(EvalTest, ParseEvalWeightsRejectsInvalidLines) {
+    for (const char *s : {"unknown 1\n", "hp\n", "hp x\n", "hp 1 2\n"}) {
+        std::istringstream iss(s);
+        EXPECT_FALSE(ParseEvalWeights(iss)) << s;
+    }
+}
+
+TEST(EvalTest, WriteEvalWeightsRoundTrip) {
+    const EvalWeights weights = {1, -2, 3, -4, 5, -6, 7};
+    std::stringstream ss;
+    WriteEvalWeights(ss, weights);
+    std::optional<EvalWeights> parsed = ParseEvalWeights(ss);
+    ASSERT_TRUE(parsed);
+    EXPECT_EQ(*parsed, weights);
+}
+
+}  // namespace
@@ -0,0 +1,118 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "moves.h"
+#include "players.h"
+#include "random_games.h"
+#include "state.h"
+
+#include <string>
+#include <vector>
+
+using ::testing::Contains;
+using ::testing::UnorderedElementsAreArray;
+
+namespace {
+
+// Searches at a fixed depth, with iterative deepening so that the aspiration
+// window is used, but without a time limit in practice. The transposition
+// table is disabled, because reusing results of deeper searches can change
+// the values found.
+MinimaxPlayerOpts FixedDepthOpts() {
+    MinimaxPlayerOpts opts;
+    opts.max_depth = 3;
+    opts.max_time_ms = 3600 * 1000;
+    opts.tt_mb = 0;
+    return opts;
+}
+
+// Returns states sampled from random games.
+std::vector<State> SampleStates() {
+    std::vector<State> states;
+    int n = 0;
+    ForEachRandomGameState([&](const State &state, const std::vector<Turn> &) {
+        if (n++ % 10 == 5) states.push_back(state);
+    }, 2, 40);
+    return states;
+}
+
+}  // namespace
+
+TEST(MinimaxTest, SearchOptionsDoNotChangeResult) {
+    // Options that only affect pruning and move ordering must find the same
+    // minimax value and optimal turns as the plain alpha-beta search. (This
+    // doesn't hold for null-move pruning and late-move reductions.)
+    struct Variant {
+        std::string name;
+        MinimaxPlayerOpts opts;
+    };
+    std::vector<Variant> variants;
+    auto add_variant = [&](std::string name, auto modify) {
+        MinimaxPlayerOpts opts = FixedDepthOpts();
+        modify(opts);
+        variants.push_back(Variant{.name = std::move(name), .opts = opts});
+    };
+    add_variant("pvs", [](MinimaxPlayerOpts &opts) { opts.pvs = true; });
+    add_variant("aspiration_window=1", [](MinimaxPlayerOpts &opts) { opts.aspiration_window = 1; });
+    add_variant("aspiration_window=500", [](MinimaxPlayerOpts &opts) { opts.aspiration_window = 500; });
+    add_variant("ordering=heuristic", [](MinimaxPlayerOpts &opts) { opts.ordering = MinimaxPlayerOpts::HEURISTIC; });
+    add_variant("pvs,aspiration_window=1,ordering=heuristic", [](MinimaxPlayerOpts &opts) {
+        opts.pvs = true;
+        opts.aspiration_window = 1;
+        opts.ordering = MinimaxPlayerOpts::HEURISTIC;
+    });
+    add_variant("shuffle_root", [](MinimaxPlayerOpts &opts) { opts.shuffle_root = true; });
+    add_variant("shuffle_root,pvs,aspiration_window=1", [](MinimaxPlayerOpts &opts) {
+        opts.shuffle_root = true;
+        opts.pvs = true;
+        opts.aspiration_window = 1;
+    });
+
+    std::vector<State> states = SampleStates();
+    ASSERT_GE(states.size(), 5);
+    for (const State &state : states) {
+        std::optional<MinimaxSearchResult> expected = SearchMinimax(FixedDepthOpts(), state);
+        ASSERT_TRUE(expected);
+        ASSERT_FALSE(expected->best_turns.empty());
+        for (const Variant &variant : variants) {
+            std::optional<MinimaxSearchResult> actual = SearchMinimax(variant.opts, state);
+            ASSERT_TRUE(actual);
+            EXPECT_EQ(actual->value, expected->value) << variant.name << ' ' << state.Encode();
+            if (variant.opts.shuffle_root) {
+                // Only one of the optimal turns is returned.
+                ASSERT_EQ(actual->best_turns.size(), 1) << variant.name << ' ' << state.Encode();
+                EXPECT_THAT(expected->best_turns, Contains(actual->best_turns[0])) << variant.name << ' ' << state.Encode();
+            } else {
+                EXPECT_THAT(actual->best_turns, UnorderedElementsAreArray(expected->best_turns))
+                    << variant.name << ' ' << state.Encode();
+            }
+        }
+    }
+}
+
+TEST(MinimaxTest, QuiescenceSearchIncludesAreaKills) {
+    // Light's Apollo is chained next to dark Hades and can be killed by his
+    // area attack, which a depth 1 search only sees with the quiescence search.
+    State state = State::InitialNoneSummonable();
+    state.Place(LIGHT, DIONYSUS, ParseField("d2"));
+    state.Place(LIGHT, APOLLO, ParseField("e7"));
+    state.Place(DARK, HADES, ParseField("e8"));
+    state.SetHpForTest(LIGHT, APOLLO, 1);
+    state.Chain(LIGHT, APOLLO);
+    ASSERT_EQ(state.NextPlayer(), LIGHT);
+
+    MinimaxPlayerOpts opts = FixedDepthOpts();
+    opts.max_depth = 1;
+    std::optional<MinimaxSearchResult> plain = SearchMinimax(opts, state);
+    opts.qsearch = true;
+    std::optional<MinimaxSearchResult> qsearch = SearchMinimax(opts, state);
+    ASSERT_TRUE(plain && qsearch);
+    EXPECT_LT(qsearch->value, plain->value);
+
+    // The area kill is what a full search at depth 2 finds as well.
+    opts.qsearch = false;
+    opts.max_depth = 2;
+    std::optional<MinimaxSearchResult> deeper = SearchMinimax(opts, state);
+    ASSERT_TRUE(deeper);
+    EXPECT_EQ(qsearch->value, deeper->value);
+}
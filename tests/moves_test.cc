@@ -8,10 +8,15 @@ using ::testing::UnorderedElementsAreArray;
 
 #include "state.h"
 #include "moves.h"
+#include "random_games.h"
 
 #include <iostream>
 #include <cassert>
 #include <cctype>
+#include <cmath>
+#include <map>
+#include <random>
+#include <sstream>
 #include <string_view>
 #include <ranges>
 #include <vector>
@@ -139,6 +144,15 @@ field_t Flip(field_t f) {
     return FieldIndex(BOARD_SIZE - 1 - r, c);
 }
 
+// Overwrites the 10-bit code of the i-th god (light gods first) in a binary
+// encoded state (see State::EncodeTo()).
+void SetBinaryGodCode(std::array<uint8_t, State::BINARY_SIZE> &bytes, int i, unsigned code) {
+    for (int b = 0; b < 10; ++b) {
+        int bit = 1 + 10 * i + b;
+        bytes[bit / 8] = (bytes[bit / 8] & ~(1 << bit % 8)) | ((code >> b) & 1) << bit % 8;
+    }
+}
+
 struct BoardTemplate {
     std::array<char, FIELD_COUNT> data;
 
@@ -2218,3 +2232,274 @@ TEST_F(MovesTest, Moves_SixActions) {
 
     EXPECT_THAT(TurnStrings(), Contains("S>e2,S+d2,T@e1,T+e9,S>e3,S+f2"));
 }
+
+TEST_F(MovesTest, ExecuteTurnWithUndo) {
+    // Plays random games and checks that executing each turn with an undo
+    // record produces the same state as regular execution, and that undoing
+    // the turn restores the original state exactly.
+    ForEachRandomGameState([](const State &state, const std::vector<Turn> &turns) {
+        for (const Turn &turn : turns) {
+            State expected = state;
+            ::ExecuteTurn(expected, turn);
+
+            State actual = state;
+            StateUndo undo;
+            ::ExecuteTurn(actual, turn, undo);
+            ASSERT_EQ(actual, expected) << turn;
+
+            UndoTurn(actual, undo);
+            ASSERT_EQ(actual, state) << turn;
+        }
+    });
+}
+
+TEST_F(MovesTest, HashAndEvalTermsAreUpdatedIncrementally) {
+    // Plays random games and checks that the incrementally updated hash and
+    // evaluation terms match the ones calculated from scratch after every
+    // turn, after decoding, and after undoing a turn.
+    ForEachRandomGameState([](const State &state, const std::vector<Turn> &turns) {
+        ASSERT_EQ(state.Hash(), state.ComputeHash());
+        ASSERT_EQ(state.GetEvalTerms(), state.ComputeEvalTerms());
+        for (const Turn &turn : turns) {
+            State next = state;
+            StateUndo undo;
+            ::ExecuteTurn(next, turn, undo);
+            ASSERT_EQ(next.Hash(), next.ComputeHash()) << turn;
+            ASSERT_NE(next.Hash(), state.Hash()) << turn;
+            ASSERT_EQ(next.GetEvalTerms(), next.ComputeEvalTerms()) << turn;
+
+            std::optional<State> decoded = State::Decode(next.Encode());
+            ASSERT_TRUE(decoded);
+            ASSERT_EQ(decoded->Hash(), next.Hash()) << turn;
+            ASSERT_EQ(decoded->GetEvalTerms(), next.GetEvalTerms()) << turn;
+
+            UndoTurn(next, undo);
+            ASSERT_EQ(next.Hash(), state.Hash()) << turn;
+            ASSERT_EQ(next.GetEvalTerms(), state.GetEvalTerms()) << turn;
+        }
+    });
+}
+
+TEST_F(MovesTest, BinaryEncodingRoundTrips) {
+    // Plays random games and checks that every state reached is restored
+    // exactly by DecodeFrom(), including derived status effects, and matches
+    // the string encoding.
+    std::array<uint8_t, State::BINARY_SIZE> bytes;
+    ForEachRandomGameState([&bytes](const State &state, const std::vector<Turn> &turns) {
+        for (const Turn &turn : turns) {
+            State next = state;
+            ::ExecuteTurn(next, turn);
+            next.EncodeTo(bytes);
+            std::optional<State> decoded = State::DecodeFrom(bytes);
+            ASSERT_TRUE(decoded) << next.Encode();
+            ASSERT_EQ(*decoded, next) << next.Encode();
+            ASSERT_EQ(decoded->Encode(), next.Encode());
+        }
+    });
+}
+
+TEST_F(MovesTest, BinaryDecodingRejectsInvalidInput) {
+    std::array<uint8_t, State::BINARY_SIZE> bytes;
+    State::InitialAllSummonable().EncodeTo(bytes);
+    ASSERT_TRUE(State::DecodeFrom(bytes));
+
+    auto in_play = [](int field, int hp) { return 3 + (field * MAX_HIT_POINTS + hp - 1) * 2; };
+    std::array<uint8_t, State::BINARY_SIZE> invalid;
+
+    // Trailing bits must be zero.
+    invalid = bytes;
+    invalid.back() = 1;
+    EXPECT_FALSE(State::DecodeFrom(invalid));
+
+    // Two gods on the same field.
+    invalid = bytes;
+    SetBinaryGodCode(invalid, ZEUS, in_play(10, 10));
+    ASSERT_TRUE(State::DecodeFrom(invalid));
+    SetBinaryGodCode(invalid, GOD_COUNT + ZEUS, in_play(10, 10));
+    EXPECT_FALSE(State::DecodeFrom(invalid));
+
+    // More hit points than the god has.
+    invalid = bytes;
+    SetBinaryGodCode(invalid, ATHENA, in_play(10, pantheon[ATHENA].hit + 1));
+    EXPECT_FALSE(State::DecodeFrom(invalid));
+
+    // Invalid field index.
+    invalid = bytes;
+    SetBinaryGodCode(invalid, ZEUS, in_play(FIELD_COUNT, 1));
+    EXPECT_FALSE(State::DecodeFrom(invalid));
+}
+
+TEST_F(MovesTest, StagedTurnGeneratorGeneratesAllTurns) {
+    // Plays random games and checks that the staged generator produces exactly
+    // the same turns as GenerateTurns(), with winning turns first.
+    StagedTurnGenerator generator;
+    std::vector<Turn> stage_turns;
+    ForEachRandomGameState([&](const State &state, const std::vector<Turn> &expected) {
+        std::vector<Turn> actual;
+        generator.Reset(state);
+        if (state.Hash() % 2) {
+            // Contains() generates some turns early, which must not change
+            // the turns returned.
+            ASSERT_TRUE(generator.Contains(expected[state.Hash() / 2 % expected.size()]));
+        }
+        while (generator.Next(stage_turns)) {
+            ASSERT_FALSE(stage_turns.empty());
+            actual.insert(actual.end(), stage_turns.begin(), stage_turns.end());
+        }
+        ASSERT_FALSE(generator.Next(stage_turns));
+        ASSERT_THAT(actual, UnorderedElementsAreArray(expected));
+
+        // If any turn wins the game, the first turn must win too.
+        bool any_win = std::ranges::any_of(expected, [&state](const Turn &turn) {
+            State next = state;
+            ::ExecuteTurn(next, turn);
+            return next.Winner() == state.NextPlayer();
+        });
+        State first = state;
+        ::ExecuteTurn(first, actual[0]);
+        EXPECT_EQ(first.Winner() == state.NextPlayer(), any_win) << state.Encode();
+    });
+}
+
+TEST_F(MovesTest, StagedTurnGeneratorAreaKills) {
+    // Same board as Hades_Attacks: Hades' area attack kills Athena, who is
+    // not on the attacked field itself, so the turn must be a kill.
+    state = BoardTemplate(
+            "     .     "
+            "    ...    "
+            "   .....   "
+            "  ..Hp...  "
+            " .m.So.... "
+            "  .zn.a..  "
+            "   ..d..   "
+            "    ...    "
+            "     .     "
+    ).ToState(LIGHT);
+    std::optional<Turn> kill = FindTurn("S!d5");
+    ASSERT_TRUE(kill);
+    EXPECT_EQ(AttackedEnemies(state, kill->actions[0]), FieldMask(fi(DARK, POSEIDON)) |
+            FieldMask(fi(DARK, APOLLO)) | FieldMask(fi(DARK, ATHENA)) | FieldMask(fi(DARK, ZEUS)));
+    EXPECT_EQ(ClassifyTurn(state, *kill), StagedTurnGenerator::KILLS);
+
+    StagedTurnGenerator generator;
+    generator.Reset(state);
+    std::vector<Turn> turns;
+    while (generator.Next(turns) && generator.LastStage() < StagedTurnGenerator::KILLS) {}
+    EXPECT_EQ(generator.LastStage(), StagedTurnGenerator::KILLS);
+    EXPECT_THAT(turns, Contains(*kill));
+
+    // Without Athena, the same attack is an ordinary attack.
+    Remove(DARK, ATHENA);
+    kill = FindTurn("S!d5");
+    ASSERT_TRUE(kill);
+    EXPECT_EQ(ClassifyTurn(state, *kill), StagedTurnGenerator::ATTACKS);
+}
+
+TEST_F(MovesTest, StagedTurnGeneratorContains) {
+    // Turns that are not legal in the current state, e.g. from a hash
+    // collision in the transposition table, must be rejected.
+    ExecuteTurn("Z@e1");
+    StagedTurnGenerator generator;
+    generator.Reset(state);
+    EXPECT_FALSE(generator.Contains(Turn{.naction = 0, .actions = {}}));
+    for (std::string_view sv : {"Z@e9", "N@e9,N>e8"}) {
+        std::optional<Turn> turn = FindTurn(sv);
+        ASSERT_TRUE(turn) << sv;
+        EXPECT_TRUE(generator.Contains(*turn)) << sv;
+    }
+    // Not legal for dark: summoning on the wrong gate, and moving or
+    // attacking with gods that are not in play.
+    for (std::string_view sv : {"Z@e1", "E>e8", "Z!e1"}) {
+        std::istringstream iss{std::string(sv)};
+        Turn turn;
+        ASSERT_TRUE(iss >> turn) << sv;
+        EXPECT_FALSE(generator.Contains(turn)) << sv;
+    }
+}
+
+TEST_F(MovesTest, GenerateUniqueTurns) {
+    // Plays random games and checks that GenerateUniqueTurns() returns a subset
+    // of all turns that leads to exactly the same set of distinct states.
+    std::vector<Turn> unique_turns;
+    StateHashSet seen;
+    ForEachRandomGameState([&](const State &state, const std::vector<Turn> &all_turns) {
+        GenerateUniqueTurns(state, unique_turns, seen);
+        ASSERT_LE(unique_turns.size(), all_turns.size());
+
+        auto successors = [&state](const std::vector<Turn> &turns) {
+            std::vector<std::string> res;
+            for (const Turn &turn : turns) {
+                State next = state;
+                ::ExecuteTurn(next, turn);
+                res.push_back(next.Encode());
+            }
+            std::ranges::sort(res);
+            return res;
+        };
+        std::vector<std::string> all_states = successors(all_turns);
+        all_states.erase(std::unique(all_states.begin(), all_states.end()), all_states.end());
+        std::vector<std::string> unique_states = successors(unique_turns);
+        ASSERT_EQ(unique_states, all_states) << state.Encode();
+    });
+}
+
+TEST_F(MovesTest, SampleTurnIsUniform) {
+    // Samples many turns from a few midgame states, and checks that only valid
+    // turns are returned, with roughly equal frequency (using a chi-squared
+    // test with a generous bound, since the seed is fixed anyway). Note that
+    // GenerateTurns() may return the same turn more than once, in which case
+    // it should be sampled proportionally more often.
+    std::mt19937 game_rng(42);
+    rng_t rng(42);
+    constexpr int samples_per_turn = 100;
+    state = State::InitialAllSummonable();
+    for (int n = 0; n < 30 && !state.IsAlmostOver(); ++n) {
+        std::vector<Turn> turns = GenerateTurns(state);
+        if (n % 10 == 0) {
+            std::map<Turn, int> multiplicity, counts;
+            for (const Turn &turn : turns) ++multiplicity[turn], counts[turn] = 0;
+            for (size_t i = 0; i < samples_per_turn * turns.size(); ++i) {
+                Turn turn = SampleTurn(state, rng);
+                auto it = counts.find(turn);
+                ASSERT_NE(it, counts.end()) << state.Encode() << ' ' << turn;
+                ++it->second;
+            }
+            double chi2 = 0;
+            for (const auto &[turn, count] : counts) {
+                double expected = samples_per_turn * multiplicity[turn];
+                chi2 += (count - expected) * (count - expected) / expected;
+            }
+            double df = counts.size() - 1;
+            EXPECT_LT(chi2, df + 6 * std::sqrt(2 * df)) << state.Encode();
+        }
+        ::ExecuteTurn(state, turns[game_rng() % turns.size()]);
+    }
+}
+
+TEST_F(MovesTest, CanWinThisTurnMatchesGeneratedTurns) {
+    // Plays random games and checks CanWinThisTurn() and GateThreats() against
+    // the generated turns. GateThreats() should contain exactly the gods that
+    // can reach the gate with their own moves only (including Dionysus' jumps).
+    int wins = 0;
+    ForEachRandomGameState([&wins](const State &state, const std::vector<Turn> &turns) {
+        const Player player = state.NextPlayer();
+        const field_t gate = gate_index[Other(player)];
+        bool any_win = false;
+        god_mask_t expected_threats = 0;
+        for (const Turn &turn : turns) {
+            State next = state;
+            ::ExecuteTurn(next, turn);
+            if (next.Winner() != player) continue;
+            any_win = true;
+            const Action &last = turn.actions[turn.naction - 1];
+            bool only_moves = std::all_of(turn.actions, turn.actions + turn.naction, [&](const Action &a) {
+                return a.god == last.god && (a.type == Action::MOVE || (a.type == Action::SPECIAL && a.god == DIONYSUS));
+            });
+            if (only_moves && last.field == gate) expected_threats |= GodMask(last.god);
+        }
+        wins += any_win;
+        ASSERT_EQ(CanWinThisTurn(state), any_win) << state.Encode();
+        ASSERT_EQ(GateThreats(state, player), expected_threats) << state.Encode();
+    }, 50, 200);
+    EXPECT_GT(wins, 0);
+}
@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+
+#include "perft.h"
+#include "state.h"
+
+#include <cstdint>
+#include <string>
+
+namespace {
+
+struct PerftPosition {
+    std::string state;  // empty for the initial state
+    int64_t counts[4];  // perft counts at depth 1 through 4, or 0 if unknown
+};
+
+// Known perft counts, taken from the original copy-based turn generator.
+// These should only change if the rules implemented by the turn generator
+// change.
+const PerftPosition perft_positions[] = {
+    {"",                                            {100, 10100, 1002167, 100891943}},
+    {"AEUUSAQlCqpDCpppqBGdQkOoQqmMpjCaIFIppeC",     {36, 1966, 75327, 0}},
+    {"BqCSqDOXMACJKbKfIBGqMGLClSqiIoMWKqZKpppnG",   {87, 9657, 822779, 88820307}},
+    {"ADGFQppWCCIrrrrrrrrrrrrXKIKTCpplG",           {49, 2412, 110430, 0}},
+    {"ACVkSpcMQGBMpGGpppFGOUoSpdOnCpVKpqpHGlC",     {85, 4736, 389375, 0}},
+    {"ADUqBQMOqbMrrrrrrrrrrrrJKhKqUImGq",           {67, 4996, 316344, 0}},
+    {"BESDSpAMeNprrrrrrrrrrrriKFEhIpkGlG",          {57, 1074, 61817, 0}},
+};
+
+// Depth 4 takes a few seconds in an optimized build, so is disabled by default.
+constexpr int max_test_depth = 3;
+
+State GetState(const PerftPosition &position) {
+    if (position.state.empty()) return State::InitialAllSummonable();
+    std::optional<State> state = State::Decode(position.state);
+    EXPECT_TRUE(state) << position.state;
+    return state ? *state : State::InitialAllSummonable();
+}
+
+}  // namespace
+
+TEST(PerftTest, DepthZero) {
+    EXPECT_EQ(Perft(State::InitialAllSummonable(), 0), 1);
+}
+
+TEST(PerftTest, KnownCounts) {
+    for (const PerftPosition &position : perft_positions) {
+        State state = GetState(position);
+        for (int depth = 1; depth <= max_test_depth; ++depth) {
+            if (position.counts[depth - 1] == 0) continue;
+            EXPECT_EQ(Perft(state, depth), position.counts[depth - 1])
+                << "state=" << position.state << " depth=" << depth;
+        }
+    }
+}
+
+TEST(PerftTest, DivideSumsToTotal) {
+    for (const PerftPosition &position : perft_positions) {
+        State state = GetState(position);
+        for (int threads : {1, 3}) {
+            int64_t total = 0;
+            for (const PerftDivideResult &result : PerftDivide(state, 2, threads)) {
+                total += result.count;
+            }
+            EXPECT_EQ(total, position.counts[1]) << "state=" << position.state << " threads=" << threads;
+        }
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef RANDOM_GAMES_H_INCLUDED
+#define RANDOM_GAMES_H_INCLUDED
+
+#include "moves.h"
+#include "state.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <utility>
+#include <vector>
+
+// Plays `games` random games of at most `max_turns` turns each, and calls
+// `visit(state, turns)` for every state reached before the game is over, with
+// all turns of that state (see GenerateTurns()). The next state is reached by
+// a random one of these turns. The seed is fixed, so every run visits the same
+// states. Stops early after a fatal test failure.
+template<class Visit>
+void ForEachRandomGameState(Visit visit, int games = 10, int max_turns = 100) {
+    std::mt19937 rng(42);
+    std::vector<Turn> turns;
+    for (int game = 0; game < games; ++game) {
+        State state = State::InitialAllSummonable();
+        for (int n = 0; n < max_turns && !state.IsOver(); ++n) {
+            GenerateTurns(state, turns);
+            visit(std::as_const(state), std::as_const(turns));
+            if (testing::Test::HasFatalFailure()) return;
+            ExecuteTurn(state, turns[rng() % turns.size()]);
+        }
+    }
+}
+
+#endif  // ndef RANDOM_GAMES_H_INCLUDED
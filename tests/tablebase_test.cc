@@ -0,0 +1,175 @@
+#include <gtest/gtest.h>
+
+#include "moves.h"
+#include "state.h"
+#include "tablebase.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include <unistd.h>
+
+namespace {
+
+// Athena against Hades: small enough to generate quickly, and includes
+// chained positions.
+const Material test_material = {{GodMask(ATHENA), GodMask(HADES)}};
+
+// Returns the result that follows from the results of the successors of
+// `state`: a win if some turn wins immediately or leads to a loss for the
+// opponent, otherwise a draw if some turn leads to a draw, otherwise a loss.
+TablebaseResult ResultFromSuccessors(const Tablebase &tablebase, const State &state) {
+    int fastest_win = 0, slowest_loss = 0;
+    bool draw = false;
+    for (const Turn &turn : GenerateTurns(state)) {
+        State next = state;
+        ExecuteTurn(next, turn);
+        if (next.IsOver()) return TablebaseResult{.outcome = 1, .turns = 1};
+        std::optional<TablebaseResult> result = tablebase.Probe(next);
+        EXPECT_TRUE(result.has_value()) << next.Encode();
+        if (!result) continue;
+        if (result->outcome < 0) {
+            fastest_win = fastest_win ? std::min(fastest_win, result->turns + 1) : result->turns + 1;
+        } else if (result->outcome == 0) {
+            draw = true;
+        } else {
+            slowest_loss = std::max(slowest_loss, result->turns + 1);
+        }
+    }
+    if (fastest_win) return TablebaseResult{.outcome = 1, .turns = fastest_win};
+    if (draw) return TablebaseResult{.outcome = 0, .turns = 0};
+    return TablebaseResult{.outcome = -1, .turns = slowest_loss};
+}
+
+class TablebaseTest : public testing::Test {
+protected:
+    static void SetUpTestSuite() {
+        // Unique per process, since tests may run concurrently.
+        path = new std::string(testing::TempDir() + "tablebase_test." + std::to_string(getpid()) + ".tb");
+        ASSERT_TRUE(GenerateTablebase(std::span(&test_material, 1), *path, nullptr));
+    }
+
+    static void TearDownTestSuite() {
+        std::remove(path->c_str());
+        delete path;
+        path = nullptr;
+    }
+
+    static std::string *path;
+};
+
+std::string *TablebaseTest::path = nullptr;
+
+}  // namespace
+
+TEST(MaterialTest, ParseAndToString) {
+    EXPECT_EQ(Material::Parse("N/S"), test_material);
+    EXPECT_EQ(test_material.ToString(), "N/S");
+    EXPECT_EQ(test_material.Count(), 2);
+
+    std::optional<Material> material = Material::Parse("SZ/");
+    ASSERT_TRUE(material.has_value());
+    EXPECT_EQ(material->gods[LIGHT], GodMask(ZEUS) | GodMask(HADES));
+    EXPECT_EQ(material->gods[DARK], 0);
+    EXPECT_EQ(material->ToString(), "ZS/");
+
+    EXPECT_FALSE(Material::Parse("ZS"));
+    EXPECT_FALSE(Material::Parse("ZZ/S"));
+    EXPECT_FALSE(Material::Parse("Z/X"));
+}
+
+TEST(MaterialTest, Of) {
+    State state = State::InitialNoneSummonable();
+    EXPECT_EQ(Material::Of(state).Count(), 0);
+    state.Place(LIGHT, ATHENA, 10);
+    state.Place(DARK, HADES, 20);
+    EXPECT_EQ(Material::Of(state), test_material);
+}
+
+TEST_F(TablebaseTest, OpenFailsForInvalidFiles) {
+    EXPECT_EQ(Tablebase::Open(testing::TempDir() + "does_not_exist.tb"), nullptr);
+
+    std::string invalid_path = *path + ".invalid";
+    std::ofstream(invalid_path) << "This is not a tablebase, but it is long enough to have a header.";
+    EXPECT_EQ(Tablebase::Open(invalid_path), nullptr);
+    std::remove(invalid_path.c_str());
+}
+
+TEST_F(TablebaseTest, ProbeOnlyCoveredStates) {
+    std::unique_ptr<Tablebase> tablebase = Tablebase::Open(*path);
+    ASSERT_NE(tablebase, nullptr);
+    EXPECT_EQ(tablebase->MaxGods(), 2);
+
+    // Gods left to summon.
+    EXPECT_FALSE(tablebase->Probe(State::InitialAllSummonable()));
+
+    // Material without a table.
+    State state = State::InitialNoneSummonable();
+    state.Place(LIGHT, ZEUS, 10);
+    state.Place(DARK, HADES, 20);
+    EXPECT_FALSE(tablebase->Probe(state));
+
+    // Sub-materials are included.
+    state = State::InitialNoneSummonable();
+    state.Place(DARK, HADES, 20);
+    EXPECT_TRUE(tablebase->Probe(state));
+}
+
+TEST_F(TablebaseTest, WinInOneTurn) {
+    std::unique_ptr<Tablebase> tablebase = Tablebase::Open(*path);
+    ASSERT_NE(tablebase, nullptr);
+
+    field_mask_t neighbors = StepMask(ALL8, gate_index[DARK]);
+    State state = State::InitialNoneSummonable();
+    state.Place(LIGHT, ATHENA, PopField(neighbors));
+    state.Place(DARK, HADES, gate_index[LIGHT] + 1);
+    EXPECT_EQ(tablebase->Probe(state), (TablebaseResult{.outcome = 1, .turns = 1}));
+}
+
+// Checks every position of the test material against its successors, which
+// verifies both the indexing and the retrograde analysis.
+TEST_F(TablebaseTest, ResultsAreConsistent) {
+    std::unique_ptr<Tablebase> tablebase = Tablebase::Open(*path);
+    ASSERT_NE(tablebase, nullptr);
+
+    int positions = 0, wins = 0, losses = 0;
+    for (field_t athena = 0; athena < FIELD_COUNT; ++athena) {
+        for (field_t hades = 0; hades < FIELD_COUNT; ++hades) {
+            if (athena == hades) continue;
+            for (int athena_hp = 1; athena_hp <= pantheon[ATHENA].hit; ++athena_hp) {
+                for (int hades_hp = 1; hades_hp <= pantheon[HADES].hit; ++hades_hp) {
+                    for (bool chained : {false, true}) {
+                        if (chained && !(StepMask(ALL8, athena) & FieldMask(hades))) continue;
+                        for (Player player : {LIGHT, DARK}) {
+                            State state = State::InitialNoneSummonable();
+                            state.Place(LIGHT, ATHENA, athena);
+                            state.Place(DARK, HADES, hades);
+                            if (state.IsOver()) continue;
+                            if (athena_hp < pantheon[ATHENA].hit) {
+                                state.DealDamage(LIGHT, ATHENA, pantheon[ATHENA].hit - athena_hp);
+                            }
+                            if (hades_hp < pantheon[HADES].hit) {
+                                state.DealDamage(DARK, HADES, pantheon[HADES].hit - hades_hp);
+                            }
+                            if (chained) state.Chain(LIGHT, ATHENA);
+                            if (player != state.NextPlayer()) state.EndTurn();
+
+                            std::optional<TablebaseResult> result = tablebase->Probe(state);
+                            ASSERT_TRUE(result.has_value()) << state.Encode();
+                            ASSERT_EQ(*result, ResultFromSuccessors(*tablebase, state)) << state.Encode();
+                            ++positions;
+                            wins += result->outcome > 0;
+                            losses += result->outcome < 0;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    EXPECT_GT(positions, 0);
+    EXPECT_GT(wins, 0);
+    EXPECT_GT(losses, 0);
+}
@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+
+#include "moves.h"
+#include "transposition_table.h"
+
+namespace {
+
+Turn MakeTurn(int naction) {
+    Turn turn = {};
+    turn.naction = naction;
+    for (int i = 0; i < naction; ++i) {
+        turn.actions[i] = Action{
+            .type  = static_cast<Action::Type>(i % 4),
+            .god   = static_cast<God>(GOD_COUNT - 1 - i),
+            .field = static_cast<field_t>(FIELD_COUNT - 1 - 7*i),
+        };
+    }
+    return turn;
+}
+
+}  // namespace
+
+TEST(TranspositionTableTest, Disabled) {
+    TranspositionTable tt(0);
+    EXPECT_FALSE(tt.Enabled());
+    Turn turn = MakeTurn(1);
+    tt.Store(42, 3, Bound::EXACT, 100, &turn);
+    TranspositionEntry entry;
+    EXPECT_FALSE(tt.Probe(42, entry));
+}
+
+TEST(TranspositionTableTest, StoreAndProbe) {
+    TranspositionTable tt(1);
+    for (int naction = 0; naction <= Turn::MAX_ACTION; ++naction) {
+        uint64_t key = 0x123456789abcdef0 + naction;
+        Turn turn = MakeTurn(naction);
+        tt.Store(key, naction + 1, Bound::LOWER, -100000005, &turn);
+
+        TranspositionEntry entry;
+        ASSERT_TRUE(tt.Probe(key, entry));
+        EXPECT_EQ(entry.score, -100000005);
+        EXPECT_EQ(entry.depth, naction + 1);
+        EXPECT_EQ(entry.bound, Bound::LOWER);
+        EXPECT_EQ(entry.best_turn, turn);
+    }
+    TranspositionEntry entry;
+    EXPECT_FALSE(tt.Probe(0x0fedcba987654321, entry));
+}
+
+TEST(TranspositionTableTest, KeepsBestTurnWithoutNewOne) {
+    TranspositionTable tt(1);
+    Turn turn = MakeTurn(Turn::MAX_ACTION);
+    tt.Store(7, 2, Bound::EXACT, 10, &turn);
+    tt.Store(7, 3, Bound::UPPER, 5, nullptr);
+
+    TranspositionEntry entry;
+    ASSERT_TRUE(tt.Probe(7, entry));
+    EXPECT_EQ(entry.score, 5);
+    EXPECT_EQ(entry.depth, 3);
+    EXPECT_EQ(entry.bound, Bound::UPPER);
+    EXPECT_EQ(entry.best_turn, turn);
+}
+
+TEST(TranspositionTableTest, Clear) {
+    TranspositionTable tt(1);
+    tt.Store(7, 2, Bound::EXACT, 10, nullptr);
+    tt.Clear();
+    TranspositionEntry entry;
+    EXPECT_FALSE(tt.Probe(7, entry));
+}